@@ -0,0 +1,63 @@
+// headers/availability.h
+#ifndef AVAILABILITY_H
+#define AVAILABILITY_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "federated.h"
+
+// ----------------------------------------------------------------
+// Copies on the shelf per title and branch, held in memory so "which
+// branch nearest to me has one" is a binary search instead of a query
+// per branch file. Titles are keyed by ISBN-13 (books.isbn13), the one
+// thing that identifies a title across files. Layout: a sorted array
+// of keys and, per key, one 16-bit count per branch next to each
+// other, so a lookup touches a single short row.
+//
+// Every file has a read-only connection of its own. refresh() re-reads
+// the books.quantity column of a file whose PRAGMA data_version moved,
+// at most once per ttl, so answers can be that much behind the desks.
+// ----------------------------------------------------------------
+struct BranchSite {
+    int    branchID = 0;
+    double lat      = 0;
+    double lon      = 0;
+};
+
+struct BranchStock {
+    int branchID  = 0;
+    int available = 0;
+};
+
+struct NearestCopy {
+    int    branchID  = 0;    // 0: no branch has a copy on the shelf
+    int    available = 0;
+    double km        = -1;   // -1 when either branch has no location
+};
+
+class AvailabilityIndex {
+public:
+    // Branches without a site are tried after all located ones, by id
+    AvailabilityIndex(const std::vector<Shard>& shards, const std::vector<BranchSite>& sites);
+    ~AvailabilityIndex();
+    AvailabilityIndex(const AvailabilityIndex&) = delete;
+    AvailabilityIndex& operator=(const AvailabilityIndex&) = delete;
+
+    bool ok() const;   // every file opened
+    // Re-read the files that changed. A call that finds another refresh
+    // running returns at once, keeping the answers as they were, unless
+    // the index has not been built yet; then it waits for that build
+    void refresh(int ttlMs);
+    std::vector<BranchStock> stock(int64_t isbn13) const;   // every branch, shard order
+    // fromBranch itself first, then the others by distance
+    NearestCopy nearest(int64_t isbn13, int fromBranch) const;
+    size_t titles() const;
+    size_t bytes() const;     // memory held by keys and counts
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+#endif // AVAILABILITY_H
@@ -0,0 +1,75 @@
+// headers/bloom.h
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ----------------------------------------------------------------
+// Bloom filter over 64-bit keys.
+// Sized from the expected number of keys and a target false-positive
+// rate; the k probe positions come from two halves of one mixed hash
+// (double hashing), so each lookup hashes the key once.
+// ----------------------------------------------------------------
+class BloomFilter {
+public:
+    BloomFilter(size_t expectedKeys, double fpRate) {
+        if (expectedKeys == 0) expectedKeys = 1;
+        const double ln2 = std::log(2.0);
+        double m = -static_cast<double>(expectedKeys) * std::log(fpRate) / (ln2 * ln2);
+        bitCount = (static_cast<uint64_t>(m) / 64 + 1) * 64;   // whole words
+        hashes = static_cast<int>(std::lround(m / static_cast<double>(expectedKeys) * ln2));
+        if (hashes < 1) hashes = 1;
+        bits.assign(bitCount / 64, 0);
+    }
+
+    void add(uint64_t key) {
+        uint64_t h = mix(key);
+        uint64_t a = h, b = (h >> 32) | 1;
+        for (int i = 0; i < hashes; ++i, a += b) {
+            uint64_t bit = a % bitCount;
+            bits[bit >> 6] |= uint64_t(1) << (bit & 63);
+        }
+        ++count;
+    }
+
+    // False means definitely absent; true means probably present
+    bool mayContain(uint64_t key) const {
+        uint64_t h = mix(key);
+        uint64_t a = h, b = (h >> 32) | 1;
+        for (int i = 0; i < hashes; ++i, a += b) {
+            uint64_t bit = a % bitCount;
+            if (!(bits[bit >> 6] & (uint64_t(1) << (bit & 63)))) return false;
+        }
+        return true;
+    }
+
+    size_t size()      const { return count; }
+    size_t bytes()     const { return bits.size() * sizeof(uint64_t); }
+    int    hashCount() const { return hashes; }
+
+    // Expected false-positive rate at the current fill
+    double expectedFpRate() const {
+        double fill = 1.0 - std::exp(-static_cast<double>(hashes) * static_cast<double>(count) /
+                                     static_cast<double>(bitCount));
+        return std::pow(fill, hashes);
+    }
+
+private:
+    std::vector<uint64_t> bits;
+    uint64_t bitCount = 64;
+    int      hashes   = 1;
+    size_t   count    = 0;
+
+    // splitmix64 finalizer: ISBN keys are dense, so spread every bit
+    static uint64_t mix(uint64_t x) {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+};
+
+#endif // BLOOM_H
@@ -0,0 +1,61 @@
+// headers/circulation.h
+#ifndef CIRCULATION_H
+#define CIRCULATION_H
+
+#include <string>
+#include <sqlite3.h>
+#include "result.h"
+#include "stmt.h"
+
+// ----------------------------------------------------------------
+// Copy-level checkout/checkin on one connection.
+// Statements are prepared once and reused; callers own the
+// transaction. books.quantity is kept equal to the number of
+// 'available' items by triggers (see createSchema), so nothing
+// here touches it directly. A returned copy goes straight to the
+// next waiting hold on its title, if there is one.
+// ----------------------------------------------------------------
+class Circulation {
+public:
+    explicit Circulation(sqlite3* conn);
+    bool ok() const { return prepareRC == SQLITE_OK; }
+    int  rc() const { return prepareRC; }
+
+    // Most open loans a patron may hold (0 = no limit); checked
+    // against the user_circ summary row, not by counting loans
+    void setLoanLimit(int maxOpen) { loanLimit = maxOpen; }
+
+    // What a scanned barcode refers to: a physical copy or a title
+    struct Target {
+        int bookID = 0;
+        int itemID = 0;   // 0 when the barcode named a title
+    };
+    // Item barcode, then ISBN, then numeric book ID
+    ErrorCode resolve(const std::string& barcode, Target& out);
+
+    // Available copy of bookID through the availability index
+    ErrorCode findAvailable(int bookID, int& itemID);
+
+    // Lend any available copy of bookID (or one specific copy)
+    ErrorCode checkout(int userID, int bookID, int* itemID = nullptr);
+    ErrorCode checkoutItem(int userID, int itemID);
+
+    // Close the user's latest open loan of bookID; userID 0 closes
+    // the oldest open loan of anyone (book drop). heldFor receives the
+    // patron whose hold took the copy, or 0 if it was shelved.
+    ErrorCode checkin(int bookID, int userID = 0, int* heldFor = nullptr);
+    ErrorCode checkinItem(int itemID, int* heldFor = nullptr);
+
+private:
+    sqlite3* conn;
+    int      prepareRC = SQLITE_OK;
+    int      loanLimit = 0;
+    Stmt byBarcode, hasBook, pickItem, itemInfo, takeItem, openLoan;
+    Stmt loanOfUser, loanOfAny, loanOfItem, closeLoan, releaseItem, bumpQuantity;
+    Stmt nextHold, fulfillHold, openCount;
+
+    ErrorCode lend(int userID, int bookID, int itemID);
+    ErrorCode close(int loanID, int itemID, int bookID, int* heldFor);
+};
+
+#endif // CIRCULATION_H
@@ -2,8 +2,18 @@
 #ifndef CORE_H
 #define CORE_H
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 #include <sqlite3.h>
+#include "storage.h"
+#include "result.h"
+#include "maintenance.h"
+#include "replica.h"
+#include "federated.h"
+#include "availability.h"
+#include "recommend.h"
 
 // System Initialization and Closing
 void initializeSystem();
@@ -16,6 +26,8 @@ bool isUserLoggedIn();
 bool isUserAdmin();
 int getCurrentUserID();
 sqlite3* getDB();
+std::string getDBPath();
+StorageEngine* getStorage();
 void setLoginState(bool success, int userID, bool admin);
 
 // Book Management
@@ -25,14 +37,297 @@ bool deleteBook(int bookID);
 void fetchBookList();
 void fetchBookDetailsByID(int bookID);
 void searchBookByKeyword(const std::string& keyword);
+// Titles or authors containing keyword (surrounding blanks ignored,
+// ASCII case-insensitive), by id. Identical concurrent searches share
+// one scan and one result list, and results are reused for a short
+// TTL; catalogue writes (here or by another connection) drop them.
+// Shelf counts in a reused result may be up to one TTL old.
+using BookList = std::shared_ptr<const std::vector<Book>>;
+Result<BookList> searchBooks(const std::string& keyword);
+void setSearchCacheTtl(int millis);   // 0 disables reuse; default 2000
+struct SearchStats {
+    uint64_t searches      = 0;   // searchBooks calls
+    uint64_t scans         = 0;   // actually run against storage
+    uint64_t joined        = 0;   // shared a scan already in flight
+    uint64_t cacheHits     = 0;   // answered from the TTL cache
+    uint64_t invalidations = 0;   // cache drops after catalogue writes
+};
+SearchStats getSearchStats();
+void resetSearchStats();
+// ISBN-10 or ISBN-13, with or without hyphens
+Result<Book> findBookByIsbn(const std::string& isbn);
+
+// Authors are stored once in the authors table; names are normalized
+// (normalizeAuthor) and matched ignoring ASCII case
+struct Author {
+    int         id     = 0;
+    std::string name;
+    int         titles = 0;   // books by this author
+};
+Result<Author> findAuthor(const std::string& name);
+Result<std::vector<Author>> searchAuthors(const std::string& keyword);
+Result<std::vector<Book>> fetchBooksByAuthor(int authorID);   // ordered by title
+
+// Bulk import of catalogue records (Book::id is ignored), committing
+// every batchSize records. Existing ISBNs are screened with a Bloom
+// filter so only probable duplicates cost an index lookup.
+struct ImportResult {
+    int    imported       = 0;
+    int    duplicates     = 0;   // ISBN already present (or earlier in rows)
+    int    invalid        = 0;   // ISBN failed validation
+    int    probes         = 0;   // records the filter sent to the exact check
+    int    falsePositives = 0;   // probes that turned out to be new
+    double expectedFpRate = 0;   // filter's predicted rate at its final fill
+    double seconds        = 0;
+    Status status;               // first failure; earlier batches stay committed
+    // Measured rate: share of new records the filter wrongly flagged
+    double fpRate() const { return imported ? static_cast<double>(falsePositives) / imported : 0; }
+};
+ImportResult importBooks(const std::vector<Book>& rows, size_t batchSize = 1000);
 
 // Borrowing
 bool borrowBook(int bookID);
 bool returnBook(int bookID);
-void fetchBorrowHistory(int userID);
+// fullHistory also reads loans moved to the archive database
+void fetchBorrowHistory(int userID, bool fullHistory = false);
 void fetchOverdueStatus(int userID);
 
+// Patron status from the user_circ summary table (single-row lookup).
+// overdue is as of the last sweep, which runs at startup and can be
+// scheduled nightly through runOverdueSweep().
+struct PatronSummary {
+    int         openLoans     = 0;
+    int         overdue       = 0;
+    int         lifetimeLoans = 0;
+    std::string lastActivity;      // YYYY-MM-DD, empty if never borrowed
+};
+Result<PatronSummary> fetchPatronSummary(int userID);
+Status runOverdueSweep();
+// Most open loans per patron for checkout (0 = no limit)
+int  getLoanLimit();
+void setLoanLimit(int maxOpen);
+
+// Batch checkout for the current user in one transaction
+enum class BatchMode {
+    AllOrNothing,   // first failure rolls back the whole batch
+    Partial         // failed items are skipped, the rest commit
+};
+struct BatchItem {
+    int       bookID;
+    ErrorCode code;
+};
+struct BatchResult {
+    int                    succeeded = 0;
+    std::vector<BatchItem> items;    // per processed ID, in request order
+    Status                 status;   // transaction-level outcome
+};
+BatchResult borrowBooks(const std::vector<int>& bookIDs, BatchMode mode);
+
+// Bulk return (book drop): close the open loan of each copy, or the
+// oldest open loan of each title, committing every batchSize items
+struct BulkReturnResult {
+    int                      returned = 0;
+    std::vector<std::string> unmatched;   // identifiers with no open loan
+    double                   seconds  = 0;
+    Status                   status;      // first transaction-level failure
+    double itemsPerSecond() const { return seconds > 0 ? returned / seconds : 0; }
+};
+BulkReturnResult returnBooksBulk(const std::vector<int>& bookIDs, size_t batchSize = 256);
+// codes are item barcodes, ISBNs or book IDs
+BulkReturnResult returnItemsBulk(const std::vector<std::string>& codes, size_t batchSize = 256);
+
+// Move loans returned more than olderThanDays ago to the archive
+// database (library_archive.db), committing every batchSize loans
+struct ArchiveResult {
+    int    moved   = 0;
+    int    batches = 0;
+    double seconds = 0;
+    Status status;
+};
+ArchiveResult archiveLoans(int olderThanDays = 365, size_t batchSize = 500);
+
+// Online copy of library.db to path through the SQLite backup API.
+// The copy is of the database as it stood when the backup began; it
+// runs pagesPerStep pages at a time with a pause in between, so desks
+// keep borrowing and returning meanwhile. compress writes gzip.
+struct BackupOptions {
+    int  pagesPerStep = 256;
+    int  pauseMs      = 5;
+    bool compress     = false;
+};
+struct BackupResult {
+    int     pages           = 0;
+    int     steps           = 0;
+    double  seconds         = 0;   // copying pages
+    double  pagesPerSecond  = 0;
+    double  compressSeconds = 0;
+    int64_t bytes           = 0;   // size of the file written
+    Status  status;
+};
+BackupResult backupDatabase(const std::string& path, const BackupOptions& options = BackupOptions());
+
+// Contention metrics for circulation write transactions
+struct ContentionStats {
+    uint64_t transactions = 0;   // logical borrow/return transactions
+    uint64_t busyRetries  = 0;   // attempts repeated after SQLITE_BUSY
+    uint64_t busyFailures = 0;   // gave up after the retry budget
+    uint64_t noCopies     = 0;   // compare-and-take found no copy
+    uint64_t waitMicros   = 0;   // total backoff sleep
+    uint64_t handlerWaits = 0;   // sleeps in the busy handler (lock held elsewhere)
+};
+ContentionStats getContentionStats();
+void resetContentionStats();
+
+// Busy policy: while another connection (often another app instance)
+// holds the write lock, a statement waits in SQLite's busy handler
+// with jittered exponential backoff for up to waitBudgetMs; a
+// transaction that still fails with Busy is rerun up to maxAttempts
+// times. Budgets are per operation class.
+enum class OpClass {
+    Interactive,    // borrow, return, holds, catalogue edits
+    Batch,          // imports, bulk returns
+    Maintenance     // overdue sweep, archival
+};
+struct BusyPolicy {
+    int waitBudgetMs;   // per lock wait, inside the busy handler
+    int maxAttempts;    // whole-transaction attempts
+    int baseDelayMs;    // first backoff; doubles each time, with jitter
+    int maxDelayMs;     // backoff cap
+};
+BusyPolicy getBusyPolicy(OpClass op);
+void setBusyPolicy(OpClass op, const BusyPolicy& policy);
+// Install the busy handler on another connection (initializeSystem
+// does this for its own)
+void enableBusyHandling(sqlite3* conn);
+
+// Background checkpoints and upkeep on library.db (maintenance.h),
+// and on every branch file with a thread per file, branches added
+// later included. While it runs, automatic checkpoints are off on
+// this connection, the branch connections and every registered
+// writer; closeSystem stops it.
+Status startMaintenance(const MaintenanceConfig& config = MaintenanceConfig());
+void stopMaintenance();
+MaintenanceStats getMaintenanceStats();   // zeros when not running
+MaintenanceStats getBranchMaintenanceStats(int branchID);   // 1: library.db
+// Other connections that write to library.db (scan pipelines, the
+// recommendation build) register here for as long as they are open
+void addWriterConnection(sqlite3* conn);
+void removeWriterConnection(sqlite3* conn);
+
+// Reports. After startReporting they read a replica of library.db
+// (replica.h) refreshed every refreshSeconds, so they may be up to that
+// far behind the desks; otherwise they read the live database.
+Status startReporting(const ReplicaConfig& config = ReplicaConfig());
+void stopReporting();
+ReplicaStats getReplicaStats();   // ageMs -1 when not running
+
+struct TitleCount {
+    int         bookID = 0;
+    std::string title;
+    std::string author;
+    int         loans  = 0;
+};
+// Most borrowed titles over the last days days, most loans first
+Result<std::vector<TitleCount>> reportTopTitles(int days = 30, int limit = 20);
+struct DayCount {
+    int day      = 0;   // day number
+    int borrowed = 0;
+    int returned = 0;
+};
+// Loans and returns per day over the last days days, oldest first;
+// days without either are left out
+Result<std::vector<DayCount>> reportDailyCirculation(int days = 30);
+
+// Branches. Branch 1 ("Main") is library.db itself; every other
+// branch keeps its catalogue, copies and loans in a file of its own,
+// opened by initializeSystem. Patrons live in library.db only, so
+// loan limits and patron summaries count loans per branch.
+struct Branch {
+    int         id = 0;
+    std::string name;
+    std::string path;
+};
+// path defaults to library_<id>.db beside library.db
+Result<Branch> tryAddBranch(const std::string& name, const std::string& path = "");
+std::vector<Branch> listBranches();                 // Main first, then by id
+StorageEngine* getBranchStorage(int branchID);      // nullptr if unknown
+Status tryAddBookAt(int branchID, const std::string& title, const std::string& author,
+                    const std::string& isbn, int year, int quantity);
+Status tryBorrowAt(int branchID, int bookID);       // current user
+Status tryReturnAt(int branchID, int bookID);
+// Every branch searched in parallel, best matches first (see
+// federated.h for the ranking); at most limit hits
+Result<std::vector<ShardHit>> searchAllBranches(const std::string& keyword, size_t limit = 100);
+
+// Copies on the shelf of one title (by ISBN) at every branch, from an
+// in-memory index refreshed at most every setAvailabilityTtl ms
+Result<std::vector<BranchStock>> fetchBranchAvailability(const std::string& isbn);
+// fromBranch if it has a copy, else the closest branch that does;
+// NoCopies if none has
+Result<NearestCopy> findNearestCopy(const std::string& isbn, int fromBranch);
+Status setBranchLocation(int branchID, double lat, double lon);
+void setAvailabilityTtl(int millis);      // default 2000; 0 checks every call
+// Move up to copies available copies of a title between branches; the
+// number moved. A copy keeps its barcode (prefixed "<home>:" while away
+// from home) and is shelved at toBranch straight away; if that part is
+// cut short, completeTransfers (run by initializeSystem) finishes it.
+Result<int> tryTransferCopies(const std::string& isbn, int fromBranch, int toBranch, int copies);
+int completeTransfers();                  // copies delivered
+
+// Holds: a returned copy is lent straight to the next waiting hold
+// on its title (higher priority first, then first come first served)
+Result<int> tryPlaceHold(int bookID, int priority = 0);   // queue position
+Status tryCancelHold(int bookID);
+bool placeHold(int bookID);
+bool cancelHold(int bookID);
+void fetchHolds(int userID);
+
+// Physical copies (items): books.quantity counts the available ones
+Result<int> findAvailableCopy(int bookID);   // item id
+struct Availability {
+    int available = 0;   // copies on the shelf
+    int copies    = 0;   // all copies, including lent ones
+    int holds     = 0;   // patrons waiting
+};
+Result<Availability> fetchAvailability(int bookID);
+Status tryAddCopy(int bookID, const std::string& barcode);
+
+// "Patrons who borrowed this also borrowed". buildRecommendations is
+// the offline job (app --recommend): it reads loans from the report
+// replica when one runs, builds the top-k lists (recommend.h) and
+// stores them in library.db a batch of books per transaction. Lookups
+// answer from the lists held in memory, reloaded within a minute of a
+// build by any instance.
+struct RecommendStats {
+    int    patrons      = 0;
+    size_t books        = 0;   // books with at least one neighbour
+    size_t pairs        = 0;
+    int    threads      = 0;
+    double loadSeconds  = 0;
+    double buildSeconds = 0;
+    double storeSeconds = 0;
+    Status status;
+};
+RecommendStats buildRecommendations(const RecommendConfig& config = RecommendConfig());
+Result<std::vector<AlsoBorrowed>> fetchAlsoBorrowed(int bookID, size_t limit = 5);
+struct BookDetails {
+    Book              book;
+    Availability      availability;
+    std::vector<Book> alsoBorrowed;   // best first
+};
+// What fetchBookDetailsByID prints, as data
+Result<BookDetails> fetchBookDetails(int bookID, size_t alsoBorrowed = 5);
+
 // User Management
 bool registerUser(const std::string& name, const std::string& role, const std::string& username, const std::string& password);
 
+// Non-throwing variants: report failures as an error code instead of a dialog
+Status tryAddBook(const std::string& title, const std::string& author, const std::string& isbn, int year, int quantity);
+Status tryEditBook(int bookID, const std::string& newTitle, const std::string& newAuthor);
+Status tryDeleteBook(int bookID);
+Status tryBorrowBook(int bookID);
+Status tryReturnBook(int bookID);
+Status tryLoginUser(const std::string& username, const std::string& password);   // NotFound: bad credentials
+Status tryRegisterUser(const std::string& name, const std::string& role, const std::string& username, const std::string& password);
+
 #endif // CORE_H
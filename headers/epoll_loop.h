@@ -0,0 +1,199 @@
+// headers/epoll_loop.h
+#ifndef EPOLL_LOOP_H
+#define EPOLL_LOOP_H
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------
+// The connection loop shared by IpcServer and HttpServer: one thread,
+// level-triggered epoll, every client read until EAGAIN and written
+// as far as the socket takes. The protocol only parses and answers:
+//
+//   void accepted(Conn&)            socket options for a new client
+//   bool serve(Conn&)               answer the complete requests at the
+//                                   front of c.in and erase them; true
+//                                   if it stopped because c.out backed up
+//   bool requestReady(const Conn&)  a whole request is at the front of
+//                                   c.in, so serve() would answer it
+//
+// A client that shuts down its side still gets answers to what it
+// sent before; once no whole request is left it is dropped, and a
+// request cut short by EOF is never waited for. A client whose
+// answers back up is not read again until they drain, and one read
+// takes at most maxReadBytes, so c.in stays bounded for a client
+// that pipelines requests without reading.
+// ----------------------------------------------------------------
+struct StreamConn {
+    int           fd       = -1;
+    std::string   in;                 // bytes received, not yet answered
+    std::string   out;                // responses not yet written
+    size_t        outPos   = 0;
+    bool          closing  = false;   // drop once out is written
+    bool          eof      = false;   // client shut down its side
+    bool          backedUp = false;   // serve() stopped on out; not read until it drains
+    std::uint32_t events   = EPOLLIN; // what epoll is watching for
+};
+
+template <typename Conn, typename Protocol>
+class EpollLoop {
+public:
+    // Takes over listenFd, a non-blocking listening socket
+    EpollLoop(int listenFd, Protocol& protocol) : listenFd(listenFd), protocol(protocol) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0 || !watch(listenFd, EPOLLIN) || !watch(wakeFd, EPOLLIN))
+            closeAll();
+    }
+    ~EpollLoop() { closeAll(); }
+    EpollLoop(const EpollLoop&) = delete;
+    EpollLoop& operator=(const EpollLoop&) = delete;
+
+    bool ok() const { return epollFd >= 0; }
+
+    // Serve until stop(); false if the loop could not run
+    bool run() {
+        if (epollFd < 0) return false;
+        epoll_event events[64];
+        for (;;) {
+            int n = epoll_wait(epollFd, events, 64, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == wakeFd) {
+                    std::uint64_t v;
+                    if (read(wakeFd, &v, sizeof v) != sizeof v) continue;
+                    // Clients see EOF instead of waiting on a stopped loop
+                    while (!conns.empty()) drop(conns.begin()->first);
+                    return true;
+                }
+                if (fd == listenFd) {
+                    acceptAll();
+                    continue;
+                }
+                auto it = conns.find(fd);
+                if (it == conns.end()) continue;
+                Conn& c = it->second;
+                bool alive = true;
+                if (!c.backedUp && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                    alive = readFrom(c);
+                // A backed-up client resumes once its output drains
+                for (bool more = alive; more; ) {
+                    c.backedUp = protocol.serve(c);
+                    alive = flush(c);
+                    more  = c.backedUp && alive && c.out.empty();
+                }
+                if (!alive) drop(fd);
+            }
+        }
+    }
+
+    // Make run() return; safe from other threads and signal handlers
+    void stop() {
+        std::uint64_t one = 1;
+        if (wakeFd >= 0) (void)!write(wakeFd, &one, sizeof one);
+    }
+
+private:
+    int                           listenFd = -1;
+    int                           epollFd  = -1;
+    int                           wakeFd   = -1;   // eventfd written by stop()
+    Protocol&                     protocol;
+    std::unordered_map<int, Conn> conns;
+
+    // Per readiness event; epoll is level-triggered, so the rest of
+    // the socket is read on the next pass once serve() has caught up
+    static constexpr size_t maxReadBytes = 1u << 20;
+
+    void closeAll() {
+        for (auto& kv : conns) ::close(kv.first);
+        conns.clear();
+        if (listenFd >= 0) ::close(listenFd);
+        if (epollFd >= 0)  ::close(epollFd);
+        if (wakeFd >= 0)   ::close(wakeFd);
+        listenFd = epollFd = wakeFd = -1;
+    }
+
+    bool watch(int fd, std::uint32_t events, int op = EPOLL_CTL_ADD) {
+        epoll_event ev{};
+        ev.events  = events;
+        ev.data.fd = fd;
+        return epoll_ctl(epollFd, op, fd, &ev) == 0;
+    }
+
+    void acceptAll() {
+        for (;;) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;   // EAGAIN: backlog drained
+            if (!watch(fd, EPOLLIN)) {
+                ::close(fd);
+                continue;
+            }
+            Conn& c = conns[fd];
+            c.fd = fd;
+            protocol.accepted(c);
+        }
+    }
+
+    void drop(int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        conns.erase(fd);
+    }
+
+    // Read up to maxReadBytes or until EAGAIN; false on error
+    bool readFrom(Conn& c) {
+        char buf[64 * 1024];
+        for (size_t got = 0; !c.eof && got < maxReadBytes; ) {
+            ssize_t r = read(c.fd, buf, sizeof buf);
+            if (r > 0) {
+                c.in.append(buf, static_cast<size_t>(r));
+                got += static_cast<size_t>(r);
+            } else if (r == 0) {
+                c.eof = true;
+            } else if (errno != EINTR) {
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+        }
+        return true;
+    }
+
+    // Write what the socket accepts; wait for EPOLLOUT for the rest.
+    // false when the connection is done with.
+    bool flush(Conn& c) {
+        while (c.outPos < c.out.size()) {
+            ssize_t w = send(c.fd, c.out.data() + c.outPos, c.out.size() - c.outPos, MSG_NOSIGNAL);
+            if (w > 0) {
+                c.outPos += static_cast<size_t>(w);
+                continue;
+            }
+            if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (w < 0 && errno == EINTR) continue;
+            return false;
+        }
+        if (c.outPos == c.out.size()) {
+            c.out.clear();
+            c.outPos = 0;
+            // Past EOF only a whole request can still produce output
+            if (c.closing || (c.eof && !protocol.requestReady(c))) return false;
+        }
+        // Past EOF the socket is always readable, and a backed-up
+        // client is not read, so those only wait to write
+        std::uint32_t events = c.eof || c.closing || c.backedUp ? EPOLLOUT
+                             : c.out.empty()                    ? EPOLLIN : EPOLLIN | EPOLLOUT;
+        if (events == c.events) return true;
+        c.events = events;
+        return watch(c.fd, events, EPOLL_CTL_MOD);
+    }
+};
+
+#endif // EPOLL_LOOP_H
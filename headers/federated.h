@@ -0,0 +1,54 @@
+// headers/federated.h
+#ifndef FEDERATED_H
+#define FEDERATED_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "storage.h"
+
+// ----------------------------------------------------------------
+// Ranked search across several library files (one per branch).
+// Every shard has a read-only connection and a worker thread of its
+// own; search() gives the query to all workers at once, each returns
+// its best limit hits in rank order, and a k-way merge over those
+// sorted lists keeps the overall best limit.
+//
+// Rank: 0 title starts with the keyword, 1 title contains it, 2 only
+// the author matches. Ties go by title (ASCII case ignored, as SQLite
+// NOCASE), then branch, then book id, so the order is stable.
+// ----------------------------------------------------------------
+struct Shard {
+    int         branchID = 0;
+    std::string path;
+};
+
+struct ShardHit {
+    int  branchID = 0;
+    int  rank     = 0;
+    Book book;
+};
+
+// Merge order used by FederatedSearch
+bool rankedBefore(const ShardHit& a, const ShardHit& b);
+
+class FederatedSearch {
+public:
+    explicit FederatedSearch(const std::vector<Shard>& shards);
+    // Finishes queries in flight, then stops the workers
+    ~FederatedSearch();
+    FederatedSearch(const FederatedSearch&) = delete;
+    FederatedSearch& operator=(const FederatedSearch&) = delete;
+
+    bool   ok() const;        // every shard opened
+    size_t size() const;
+    // keyword is matched like BookRepository::search (LIKE %keyword%);
+    // a shard that fails contributes nothing
+    std::vector<ShardHit> search(const std::string& keyword, size_t limit);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+#endif // FEDERATED_H
@@ -0,0 +1,115 @@
+// headers/flat_map.h
+#ifndef FLAT_MAP_H
+#define FLAT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// ----------------------------------------------------------------
+// Open-addressing hash map with integer keys.
+// Slots live in one contiguous vector (linear probing, power-of-two
+// capacity, backward-shift erase) so lookups touch one or two cache
+// lines instead of chasing std::unordered_map node pointers.
+// ----------------------------------------------------------------
+template <typename V>
+class FlatMap {
+public:
+    struct Slot {
+        int  key;
+        bool used;
+        V    value;
+    };
+
+    FlatMap() { slots.resize(16); }
+
+    size_t size() const { return count; }
+
+    V* find(int key) {
+        size_t i = home(key);
+        while (slots[i].used) {
+            if (slots[i].key == key) return &slots[i].value;
+            i = (i + 1) & mask();
+        }
+        return nullptr;
+    }
+    const V* find(int key) const {
+        return const_cast<FlatMap*>(this)->find(key);
+    }
+
+    // Insert or overwrite; returns reference to stored value
+    V& put(int key, V value) {
+        if ((count + 1) * 4 > slots.size() * 3) grow();
+        size_t i = home(key);
+        while (slots[i].used) {
+            if (slots[i].key == key) {
+                slots[i].value = std::move(value);
+                return slots[i].value;
+            }
+            i = (i + 1) & mask();
+        }
+        slots[i].key   = key;
+        slots[i].used  = true;
+        slots[i].value = std::move(value);
+        ++count;
+        return slots[i].value;
+    }
+
+    bool erase(int key) {
+        size_t i = home(key);
+        while (slots[i].used && slots[i].key != key) i = (i + 1) & mask();
+        if (!slots[i].used) return false;
+        // Shift following entries back so no tombstones are needed
+        size_t j = i;
+        for (;;) {
+            j = (j + 1) & mask();
+            if (!slots[j].used) break;
+            size_t h = home(slots[j].key);
+            bool movable = (i <= j) ? (h <= i || h > j) : (h <= i && h > j);
+            if (movable) {
+                slots[i] = std::move(slots[j]);
+                i = j;
+            }
+        }
+        slots[i].used  = false;
+        slots[i].value = V();
+        --count;
+        return true;
+    }
+
+    void clear() {
+        slots.assign(16, Slot());
+        count = 0;
+    }
+
+    // Visit every live entry: fn(key, value)
+    template <typename Fn>
+    void forEach(Fn fn) {
+        for (auto& s : slots) if (s.used) fn(s.key, s.value);
+    }
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const auto& s : slots) if (s.used) fn(s.key, s.value);
+    }
+
+private:
+    std::vector<Slot> slots;
+    size_t            count = 0;
+
+    size_t mask() const { return slots.size() - 1; }
+    size_t home(int key) const {
+        // Fibonacci hashing spreads sequential IDs across the table
+        uint64_t h = static_cast<uint64_t>(static_cast<uint32_t>(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h >> 32) & mask();
+    }
+    void grow() {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.resize(old.size() * 2);
+        count = 0;
+        for (auto& s : old) if (s.used) put(s.key, std::move(s.value));
+    }
+};
+
+#endif // FLAT_MAP_H
@@ -0,0 +1,47 @@
+// headers/http.h
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <memory>
+
+// ----------------------------------------------------------------
+// Embedded HTTP/1.1 front end for the web OPAC: read-only JSON over
+// the core API, without the FLTK UI. Connections are kept alive by
+// default and pipelined requests are answered in order.
+//
+//   GET /books/search?q=<keyword>[&limit=n]     -> [book, ...]
+//   GET /books/<id>                             -> book
+//   GET /books/<id>/availability                -> {id, available, copies, holds}
+//   GET /books/<id>/also-borrowed               -> [book, ...] best first
+//   GET /patrons/<id>/loans                     -> [loan, ...]
+//   GET /reports/top-titles[?days=30&limit=20]  -> [{id, title, author, loans}, ...]
+//   GET /reports/daily[?days=30]                -> [{date, borrowed, returned}, ...]
+//   GET /branches                               -> [{id, name}, ...]
+//   GET /branches/search?q=<keyword>[&limit=n]  -> [{branch, rank, book}, ...]
+//   GET /branches/availability?isbn=<isbn>[&from=1]
+//                                               -> {branches: [{id, available}, ...], nearest}
+//
+// It binds to 127.0.0.1 only: the OPAC application in front of it is
+// trusted to have authenticated the patron.
+// ----------------------------------------------------------------
+class HttpServer {
+public:
+    // Listen on 127.0.0.1:port; port 0 picks a free one (see port())
+    explicit HttpServer(int port);
+    ~HttpServer();
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    bool ok() const;
+    int  port() const;
+    // Serve on the calling thread until stop(); false if it could not run
+    bool run();
+    // Make run() return; safe from other threads and signal handlers
+    void stop();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+#endif // HTTP_H
@@ -0,0 +1,200 @@
+// headers/ipc.h
+#ifndef IPC_H
+#define IPC_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "core.h"
+
+// ----------------------------------------------------------------
+// Local IPC: one server process owns library.db and serves the core
+// API over a Unix domain socket, so desk terminals share a single
+// writer instead of contending for the file lock.
+//
+// Every message is a frame: u32 payload length, then the payload.
+//   request:  u32 id, u8 op, arguments
+//   response: u32 id, u8 ErrorCode, results (Ok) or detail string
+// Integers are little-endian; a string is a u32 length and its bytes.
+// Requests on one connection are answered in order, so a client may
+// pipeline them.
+// ----------------------------------------------------------------
+enum class IpcOp : uint8_t {
+    Login = 1,       // username, password        -> i32 userID, u8 admin
+    Logout,          //                           -> (nothing)
+    GetBook,         // i32 bookID                -> book
+    FindIsbn,        // isbn                      -> book
+    Search,          // keyword                   -> books
+    ByAuthor,        // author                    -> books
+    AddBook,         // title, author, isbn, i32 year, i32 quantity (admin)
+    EditBook,        // i32 bookID, title, author (admin)
+    DeleteBook,      // i32 bookID (admin)
+    Borrow,          // i32 bookID
+    Return,          // i32 bookID
+    PlaceHold,       // i32 bookID, i32 priority  -> i32 queue position
+    CancelHold,      // i32 bookID
+    Loans,           // i32 userID (own, or admin) -> loans
+    Summary          // i32 userID (own, or admin) -> 3 x i32, lastActivity
+};
+
+constexpr uint32_t ipcMaxFrame = 1u << 20;   // larger frames close the connection
+
+// Appends fields to a frame; frame() patches the length prefix
+class IpcWriter {
+public:
+    IpcWriter() { buf.assign(4, '\0'); }
+
+    void u8(uint8_t v)   { buf.push_back(static_cast<char>(v)); }
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; ++i) buf.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+    }
+    void i32(int32_t v)  { u32(static_cast<uint32_t>(v)); }
+    void str(std::string_view s) {
+        u32(static_cast<uint32_t>(s.size()));
+        buf.append(s.data(), s.size());
+    }
+    void book(const Book& b) {
+        i32(b.id); str(b.title); str(b.author); str(b.isbn); i32(b.year); i32(b.quantity);
+    }
+    void loan(const Loan& l) {
+        i32(l.id); i32(l.userID); i32(l.bookID); i32(l.borrowDay); i32(l.returnDay);
+    }
+
+    const std::string& frame() {
+        uint32_t n = static_cast<uint32_t>(buf.size() - 4);
+        for (int i = 0; i < 4; ++i) buf[i] = static_cast<char>((n >> (8 * i)) & 0xff);
+        return buf;
+    }
+
+private:
+    std::string buf;
+};
+
+// Reads fields from a payload; running past the end clears ok()
+class IpcReader {
+public:
+    IpcReader() = default;
+    IpcReader(const char* data, size_t size) : p(data), end(data + size) {}
+
+    bool ok()   const { return good; }
+    bool done() const { return good && p == end; }
+
+    uint8_t u8() {
+        if (!need(1)) return 0;
+        return static_cast<uint8_t>(*p++);
+    }
+    uint32_t u32() {
+        if (!need(4)) return 0;
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+        p += 4;
+        return v;
+    }
+    int32_t i32() { return static_cast<int32_t>(u32()); }
+    std::string str() {
+        uint32_t n = u32();
+        if (!need(n)) return std::string();
+        std::string s(p, n);
+        p += n;
+        return s;
+    }
+    Book book() {
+        Book b;
+        b.id = i32(); b.title = str(); b.author = str(); b.isbn = str();
+        b.year = i32(); b.quantity = i32();
+        return b;
+    }
+    Loan loan() {
+        Loan l;
+        l.id = i32(); l.userID = i32(); l.bookID = i32(); l.borrowDay = i32(); l.returnDay = i32();
+        return l;
+    }
+
+private:
+    const char* p    = nullptr;
+    const char* end  = nullptr;
+    bool        good = true;
+
+    bool need(size_t n) {
+        if (good && static_cast<size_t>(end - p) >= n) return true;
+        good = false;
+        return false;
+    }
+};
+
+// ----------------------------------------------------------------
+// Server: an epoll loop on the calling thread. The core layer must be
+// initialized first (initializeSystem); requests run one at a time on
+// its connection, with each client's login restored per request.
+// ----------------------------------------------------------------
+class IpcServer {
+public:
+    explicit IpcServer(const std::string& socketPath);
+    ~IpcServer();
+    IpcServer(const IpcServer&) = delete;
+    IpcServer& operator=(const IpcServer&) = delete;
+
+    bool ok() const;          // socket bound and listening
+    // Serve until stop(); false if the loop could not run
+    bool run();
+    // Make run() return; safe from other threads and signal handlers
+    void stop();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+// ----------------------------------------------------------------
+// Client: blocking calls mirroring the core API. Transport failures
+// come back as ErrorCode::Database and close the connection.
+// ----------------------------------------------------------------
+class IpcClient {
+public:
+    IpcClient() = default;
+    ~IpcClient();
+    IpcClient(const IpcClient&) = delete;
+    IpcClient& operator=(const IpcClient&) = delete;
+
+    Status connect(const std::string& socketPath);
+    void   close();
+    bool   connected() const { return fd >= 0; }
+
+    Status login(const std::string& username, const std::string& password);
+    Status logout();
+    int    userID()  const { return user; }
+    bool   isAdmin() const { return admin; }
+
+    Result<Book>              book(int bookID);
+    Result<Book>              bookByIsbn(const std::string& isbn);
+    Result<std::vector<Book>> search(const std::string& keyword);
+    Result<std::vector<Book>> booksByAuthor(const std::string& author);
+    Status addBook(const std::string& title, const std::string& author,
+                   const std::string& isbn, int year, int quantity);
+    Status editBook(int bookID, const std::string& title, const std::string& author);
+    Status deleteBook(int bookID);
+
+    Status      borrow(int bookID);
+    Status      returnBook(int bookID);
+    Result<int> placeHold(int bookID, int priority = 0);
+    Status      cancelHold(int bookID);
+    Result<std::vector<Loan>> loans(int userID);
+    Result<PatronSummary>     summary(int userID);
+
+private:
+    int         fd     = -1;
+    uint32_t    nextID = 1;
+    int         user   = -1;
+    bool        admin  = false;
+    std::string reply;          // payload of the last response
+
+    IpcWriter request(IpcOp op);
+    // Send req, wait for its response and check the status byte;
+    // on Ok, in is positioned at the results
+    Status call(IpcWriter& req, IpcReader& in);
+    Result<std::vector<Book>> books(IpcWriter& req);
+};
+
+#endif // IPC_H
@@ -0,0 +1,26 @@
+// headers/isbn.h
+#ifndef ISBN_H
+#define ISBN_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ----------------------------------------------------------------
+// ISBN validation and normalization. A book is keyed by its ISBN-13
+// as a 64-bit integer; ISBN-10 input is converted to the 978 form.
+// Hyphens and spaces are ignored, anything else must be a digit
+// (or a final X in an ISBN-10).
+// ----------------------------------------------------------------
+
+// ISBN-13 value of text, or 0 if it is not a valid ISBN-10/ISBN-13
+int64_t normalizeIsbn(std::string_view text);
+
+// 13-digit text form of a normalized key
+std::string isbnText(int64_t isbn13);
+
+// Normalize a batch (bulk import); out[i] is 0 where text[i] is invalid
+void normalizeIsbns(const std::vector<std::string>& text, std::vector<int64_t>& out);
+
+#endif // ISBN_H
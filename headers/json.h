@@ -0,0 +1,108 @@
+// headers/json.h
+#ifndef JSON_H
+#define JSON_H
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "storage.h"
+
+// ----------------------------------------------------------------
+// Append-only JSON writer for API responses. Output goes straight
+// into one string (no DOM); commas are placed from a small nesting
+// stack and numbers are formatted with to_chars, so a Book costs a
+// handful of appends and no allocations once the buffer has grown.
+// ----------------------------------------------------------------
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : buf(out) {}
+
+    JsonWriter& beginObject() { separate(); buf += '{'; first.push_back(true); return *this; }
+    JsonWriter& endObject()   { buf += '}'; first.pop_back(); return *this; }
+    JsonWriter& beginArray()  { separate(); buf += '['; first.push_back(true); return *this; }
+    JsonWriter& endArray()    { buf += ']'; first.pop_back(); return *this; }
+
+    // Member name inside an object; the next value belongs to it
+    JsonWriter& key(std::string_view k) {
+        separate();
+        quoted(k);
+        buf += ':';
+        afterKey = true;
+        return *this;
+    }
+
+    JsonWriter& value(std::string_view s) { separate(); quoted(s); return *this; }
+    JsonWriter& value(const char* s)      { return value(std::string_view(s)); }
+    JsonWriter& value(bool b)             { separate(); buf += b ? "true" : "false"; return *this; }
+    JsonWriter& value(int64_t n) {
+        separate();
+        char tmp[24];
+        auto r = std::to_chars(tmp, tmp + sizeof tmp, n);
+        buf.append(tmp, r.ptr);
+        return *this;
+    }
+    JsonWriter& value(int n)              { return value(static_cast<int64_t>(n)); }
+    JsonWriter& null()                    { separate(); buf += "null"; return *this; }
+
+    template <typename T>
+    JsonWriter& field(std::string_view k, const T& v) { key(k); return value(v); }
+
+    JsonWriter& book(const Book& b) {
+        beginObject();
+        field("id", b.id).field("title", b.title).field("author", b.author);
+        field("isbn", b.isbn).field("year", b.year).field("available", b.quantity);
+        return endObject();
+    }
+    // Days are written as YYYY-MM-DD; an open loan has "returned": null
+    JsonWriter& loan(const Loan& l) {
+        beginObject();
+        field("id", l.id).field("bookID", l.bookID).field("borrowed", dayToDate(l.borrowDay));
+        key("returned");
+        if (l.returnDay) value(dayToDate(l.returnDay)); else null();
+        return endObject();
+    }
+
+private:
+    std::string&      buf;
+    std::vector<bool> first;          // per open container: nothing written yet
+    bool              afterKey = false;
+
+    void separate() {
+        if (afterKey) {
+            afterKey = false;
+            return;
+        }
+        if (first.empty()) return;
+        if (first.back()) first.back() = false;
+        else              buf += ',';
+    }
+
+    void quoted(std::string_view s) {
+        static const char hex[] = "0123456789abcdef";
+        buf += '"';
+        size_t run = 0;   // bytes that need no escaping are copied in runs
+        for (size_t i = 0; i < s.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            buf.append(s.data() + run, i - run);
+            run = i + 1;
+            switch (c) {
+                case '"':  buf += "\\\""; break;
+                case '\\': buf += "\\\\"; break;
+                case '\n': buf += "\\n";  break;
+                case '\r': buf += "\\r";  break;
+                case '\t': buf += "\\t";  break;
+                default:
+                    buf += "\\u00";
+                    buf += hex[c >> 4];
+                    buf += hex[c & 0xf];
+            }
+        }
+        buf.append(s.data() + run, s.size() - run);
+        buf += '"';
+    }
+};
+
+#endif // JSON_H
@@ -0,0 +1,65 @@
+// headers/maintenance.h
+#ifndef MAINTENANCE_H
+#define MAINTENANCE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// ----------------------------------------------------------------
+// Background upkeep for a WAL-mode library.db or branch file, one
+// per file. A worker thread with its own connection checkpoints the
+// WAL every poll that saw commits, so no borrow or return pays for an
+// automatic checkpoint inline.
+// Under steady writes a passive checkpoint never quite catches up and
+// the WAL would grow without bound, so past restartFrames it is
+// followed by a RESTART, which only has the last few frames to copy.
+// Once no commit has been seen for idleMs it also truncates the WAL,
+// runs PRAGMA optimize, hands free pages back (incremental vacuum)
+// and runs the overdue sweep when the day changes.
+//
+// The worker barely waits for locks: a task that finds the database
+// busy is skipped and tried again on a later poll.
+// ----------------------------------------------------------------
+struct MaintenanceConfig {
+    int pollMs          = 1000;        // how often the worker wakes up
+    int idleMs          = 5000;        // no commits this long counts as idle
+    int restartFrames   = 1000;        // WAL length that triggers a restart attempt
+    int optimizeMinutes = 60;          // PRAGMA optimize interval, when idle
+    int vacuumPages     = 512;         // free pages released per idle poll
+};
+
+struct MaintenanceStats {
+    uint64_t checkpoints   = 0;   // passive checkpoints run
+    uint64_t restarts      = 0;   // restart checkpoints that completed
+    uint64_t truncates     = 0;   // truncate checkpoints that emptied the WAL
+    uint64_t busy          = 0;   // checkpoints cut short by readers or a writer
+    uint64_t framesCopied  = 0;   // WAL frames written back to library.db
+    uint64_t lastMicros    = 0;   // duration of the latest checkpoint
+    uint64_t maxMicros     = 0;
+    uint64_t totalMicros   = 0;
+    int64_t  walBytes      = 0;   // WAL file size at the latest poll
+    int      walFrames     = 0;   // frames in the WAL at the latest checkpoint
+    uint64_t optimizes     = 0;
+    uint64_t vacuumedPages = 0;
+    int      freePages     = 0;   // freelist length at the latest idle poll
+    uint64_t sweeps        = 0;   // overdue sweeps run
+};
+
+class MaintenanceThread {
+public:
+    MaintenanceThread(const std::string& dbPath, const MaintenanceConfig& config);
+    // Finishes the current task, then stops
+    ~MaintenanceThread();
+    MaintenanceThread(const MaintenanceThread&) = delete;
+    MaintenanceThread& operator=(const MaintenanceThread&) = delete;
+
+    bool             ok() const;      // connection opened
+    MaintenanceStats stats() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+#endif // MAINTENANCE_H
@@ -0,0 +1,62 @@
+// headers/recommend.h
+#ifndef RECOMMEND_H
+#define RECOMMEND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// ----------------------------------------------------------------
+// "Patrons who borrowed this also borrowed". Two books co-occur once
+// for every patron who has borrowed both. The build takes the distinct
+// (patron, book) pairs as a patron x book matrix A in CSR form plus its
+// transpose and works out C = At*A one row at a time (Gustavson): for
+// book i, every book of every patron of i is counted in a dense
+// per-thread accumulator, and only the row's top k survive. Rows are
+// handed to the threads in small chunks, so a few very popular books
+// do not leave the other threads idle. The kept rows are CSR too:
+// a sorted array of book ids, offsets, then (book, patrons) entries.
+// ----------------------------------------------------------------
+struct RecommendConfig {
+    int topK           = 10;
+    int minPatrons     = 2;      // co-borrowers needed to list a pair
+    int maxPatronBooks = 2000;   // patrons with more titles are left out
+    int threads        = 0;      // 0: one per core
+};
+
+struct AlsoBorrowed {
+    int bookID  = 0;
+    int patrons = 0;   // who borrowed both
+};
+
+class CoBorrowIndex {
+public:
+    CoBorrowIndex() = default;
+    // pairs: distinct (patron, book), sorted by patron then book
+    static CoBorrowIndex build(const std::vector<std::pair<int, int>>& pairs,
+                               const RecommendConfig& config);
+    // rows: (book, neighbour), sorted by book, each book's best first
+    static CoBorrowIndex fromRows(const std::vector<std::pair<int, AlsoBorrowed>>& rows);
+
+    // Best first; empty if the book has none
+    std::pair<const AlsoBorrowed*, size_t> neighbours(int bookID) const;
+    // fn(bookID, neighbours, count) for every book, by id
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (size_t r = 0; r < keys.size(); ++r)
+            fn(keys[r], entries.data() + offsets[r], offsets[r + 1] - offsets[r]);
+    }
+    size_t books() const { return keys.size(); }
+    size_t pairs() const { return entries.size(); }
+    size_t bytes() const;
+    int    patrons() const { return patronCount; }   // patrons counted by build
+
+private:
+    std::vector<int>          keys;      // book ids with neighbours, sorted
+    std::vector<uint32_t>     offsets;   // keys.size() + 1
+    std::vector<AlsoBorrowed> entries;
+    int                       patronCount = 0;
+};
+
+#endif // RECOMMEND_H
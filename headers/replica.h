@@ -0,0 +1,57 @@
+// headers/replica.h
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sqlite3.h>
+
+// ----------------------------------------------------------------
+// Read-only copy of library.db for reports, so long aggregates do not
+// compete with the desks for the live file. A worker thread with its
+// own connection refreshes it every refreshSeconds via the backup API
+// (copyDatabase), into memory or into path if one is given. A refresh
+// builds a whole new copy and swaps it in: queries keep the copy they
+// started on and never wait for a refresh. Refreshes are skipped while
+// library.db has not changed.
+// ----------------------------------------------------------------
+struct ReplicaConfig {
+    int         refreshSeconds = 60;
+    std::string path;                  // empty: in memory
+    int         pagesPerStep   = 1024;
+    int         pauseMs        = 1;
+};
+
+struct ReplicaStats {
+    uint64_t refreshes  = 0;   // copies made, including the first
+    uint64_t skipped    = 0;   // polls where library.db had not changed
+    uint64_t failures   = 0;
+    int      pages      = 0;   // size of the current copy
+    uint64_t lastMicros = 0;   // duration of the latest refresh
+    uint64_t maxMicros  = 0;
+    int64_t  ageMs      = -1;  // since the copy was last known current; -1 if none
+};
+
+class ReportReplica {
+public:
+    // Makes the first copy before returning
+    ReportReplica(const std::string& dbPath, const ReplicaConfig& config);
+    ~ReportReplica();
+    ReportReplica(const ReportReplica&) = delete;
+    ReportReplica& operator=(const ReportReplica&) = delete;
+
+    bool ok() const;   // a copy is available
+    // Current copy; it stays open while the pointer is held. Null if
+    // there is none. Read-only: writes fail with SQLITE_READONLY.
+    std::shared_ptr<sqlite3> connection() const;
+    // Copy now instead of waiting for the next poll
+    bool refresh();
+    ReplicaStats stats() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+#endif // REPLICA_H
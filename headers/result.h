@@ -0,0 +1,110 @@
+// headers/result.h
+#ifndef RESULT_H
+#define RESULT_H
+
+#include <string>
+#include <utility>
+#include <variant>
+#include <sqlite3.h>
+
+// ----------------------------------------------------------------
+// Error codes for expected failures in the database layer
+// ----------------------------------------------------------------
+enum class ErrorCode {
+    Ok = 0,
+    NotLoggedIn,     // operation needs a logged-in user
+    NotFound,        // no row matched
+    NoCopies,        // quantity is already zero
+    LoanLimit,       // patron already has the maximum open loans
+    Busy,            // SQLITE_BUSY / SQLITE_LOCKED
+    Constraint,      // UNIQUE / CHECK / FK violation
+    Database         // any other SQLite failure
+};
+
+inline const char* errorText(ErrorCode code) {
+    switch (code) {
+        case ErrorCode::Ok:          return "OK";
+        case ErrorCode::NotLoggedIn: return "Not logged in";
+        case ErrorCode::NotFound:    return "Not found";
+        case ErrorCode::NoCopies:    return "No copies available";
+        case ErrorCode::LoanLimit:   return "Loan limit reached";
+        case ErrorCode::Busy:        return "Database is busy";
+        case ErrorCode::Constraint:  return "Constraint violation";
+        case ErrorCode::Database:    return "Database error";
+    }
+    return "Unknown error";
+}
+
+// Map a SQLite result code to an ErrorCode
+inline ErrorCode fromSqlite(int rc) {
+    switch (rc & 0xff) {
+        case SQLITE_OK:
+        case SQLITE_DONE:
+        case SQLITE_ROW:        return ErrorCode::Ok;
+        case SQLITE_BUSY:
+        case SQLITE_LOCKED:     return ErrorCode::Busy;
+        case SQLITE_CONSTRAINT: return ErrorCode::Constraint;
+        default:                return ErrorCode::Database;
+    }
+}
+
+struct Error {
+    ErrorCode   code = ErrorCode::Database;
+    std::string detail;   // sqlite3_errmsg text or extra context
+
+    Error() = default;
+    Error(ErrorCode c, std::string d = std::string()) : code(c), detail(std::move(d)) {}
+    // "No copies available" or "Constraint violation: UNIQUE constraint failed: books.isbn"
+    std::string message() const {
+        return detail.empty() ? errorText(code) : std::string(errorText(code)) + ": " + detail;
+    }
+};
+
+// Build an Error from the last failure on a handle
+inline Error dbError(sqlite3* handle, int rc) {
+    return Error(fromSqlite(rc), sqlite3_errmsg(handle));
+}
+
+// ----------------------------------------------------------------
+// Result<T>: either a value or an Error, never throws
+// ----------------------------------------------------------------
+template <typename T>
+class Result {
+public:
+    Result(T value) : data(std::move(value)) {}
+    Result(Error err) : data(std::move(err)) {}
+    Result(ErrorCode code) : data(Error(code)) {}
+
+    bool ok() const { return data.index() == 0; }
+    explicit operator bool() const { return ok(); }
+
+    T&           value()       { return std::get<0>(data); }
+    const T&     value() const { return std::get<0>(data); }
+    const Error& error() const { return std::get<1>(data); }
+    ErrorCode    code()  const { return ok() ? ErrorCode::Ok : error().code; }
+
+private:
+    std::variant<T, Error> data;
+};
+
+template <>
+class Result<void> {
+public:
+    Result() = default;
+    Result(Error err) : err(std::move(err)), failed(true) {}
+    Result(ErrorCode code) : err(code), failed(code != ErrorCode::Ok) {}
+
+    bool ok() const { return !failed; }
+    explicit operator bool() const { return ok(); }
+
+    const Error& error() const { return err; }
+    ErrorCode    code()  const { return failed ? err.code : ErrorCode::Ok; }
+
+private:
+    Error err;
+    bool  failed = false;
+};
+
+using Status = Result<void>;
+
+#endif // RESULT_H
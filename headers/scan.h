@@ -0,0 +1,57 @@
+// headers/scan.h
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "result.h"
+
+// ----------------------------------------------------------------
+// Barcode scan pipeline for circulation desks.
+// Scans are queued without touching the database, then a worker
+// thread with its own connection applies them in arrival order,
+// grouping whatever is queued into one transaction. SQLITE_BUSY
+// makes the worker back off and retry the same group, so scans are
+// never dropped or reordered; only while the pipeline is destroyed is
+// the wait bounded, and scans still locked out then report Busy.
+// ----------------------------------------------------------------
+enum class ScanMode { Borrow, Return };
+
+struct ScanEvent {
+    uint64_t    seq = 0;        // submission order, starting at 1
+    std::string barcode;
+    int         bookID = 0;     // 0 if the barcode did not resolve
+    ErrorCode   code = ErrorCode::Ok;
+    int         attempts = 0;   // transaction attempts including busy retries
+};
+
+class ScanPipeline {
+public:
+    using Callback = std::function<void(const ScanEvent&)>;
+
+    // userID is the borrower in Borrow mode and ignored in Return mode.
+    // onResult runs on the worker thread, once per scan, in order.
+    ScanPipeline(const std::string& dbPath, ScanMode mode, int userID, Callback onResult);
+    // Drains everything already submitted, then stops. If another
+    // writer keeps the database locked for about 2 s, the rest of the
+    // queue gets ErrorCode::Busy instead of holding up the caller.
+    ~ScanPipeline();
+    ScanPipeline(const ScanPipeline&) = delete;
+    ScanPipeline& operator=(const ScanPipeline&) = delete;
+
+    // Queue one barcode; thread-safe and never waits on the database
+    void submit(std::string barcode);
+    // Read newline-separated barcodes from a file or FIFO ("-" = stdin)
+    // on a background thread until EOF
+    void feedFrom(const std::string& path);
+    // Scans queued or in flight
+    size_t pending() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+#endif // SCAN_H
@@ -0,0 +1,57 @@
+// headers/single_flight.h
+#ifndef SINGLE_FLIGHT_H
+#define SINGLE_FLIGHT_H
+
+#include <exception>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// ----------------------------------------------------------------
+// Duplicate call suppression: while fn() runs for a key, other
+// callers with the same key wait for it and receive the same value
+// (or exception) instead of running their own. Nothing is kept once
+// the call finishes; caching the value is up to the caller.
+// ----------------------------------------------------------------
+template <typename V>
+class SingleFlight {
+public:
+    // joined (if given) is set when the value came from another caller
+    template <typename Fn>
+    V run(const std::string& key, Fn&& fn, bool* joined = nullptr) {
+        std::promise<V>       mine;
+        std::shared_future<V> theirs;
+        {
+            std::lock_guard<std::mutex> g(lock);
+            auto it = calls.find(key);
+            if (it != calls.end()) theirs = it->second;
+            else                   calls.emplace(key, mine.get_future().share());
+        }
+        if (joined) *joined = theirs.valid();
+        if (theirs.valid()) return theirs.get();
+
+        try {
+            V value = fn();
+            finish(key);
+            mine.set_value(value);
+            return value;
+        } catch (...) {
+            finish(key);
+            mine.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+private:
+    std::mutex                                             lock;
+    std::unordered_map<std::string, std::shared_future<V>> calls;   // in flight
+
+    // Later callers start a fresh call; current waiters keep their future
+    void finish(const std::string& key) {
+        std::lock_guard<std::mutex> g(lock);
+        calls.erase(key);
+    }
+};
+
+#endif // SINGLE_FLIGHT_H
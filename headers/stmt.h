@@ -0,0 +1,176 @@
+// headers/stmt.h
+#ifndef STMT_H
+#define STMT_H
+
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <sqlite3.h>
+
+// ----------------------------------------------------------------
+// Per-type bind/column traits. Only the types specialised here can
+// be bound or read; anything else fails to compile.
+// ----------------------------------------------------------------
+namespace sqlbind {
+
+template <typename T> struct Unsupported : std::false_type {};
+
+template <typename T, typename = void>
+struct Param {
+    static_assert(Unsupported<T>::value, "type cannot be bound to a SQLite parameter");
+};
+template <> struct Param<int> {
+    static int bind(sqlite3_stmt* s, int i, int v) { return sqlite3_bind_int(s, i, v); }
+};
+template <> struct Param<bool> {
+    static int bind(sqlite3_stmt* s, int i, bool v) { return sqlite3_bind_int(s, i, v ? 1 : 0); }
+};
+template <> struct Param<long long> {
+    static int bind(sqlite3_stmt* s, int i, long long v) { return sqlite3_bind_int64(s, i, v); }
+};
+template <> struct Param<long> {
+    static int bind(sqlite3_stmt* s, int i, long v) { return sqlite3_bind_int64(s, i, v); }
+};
+template <> struct Param<double> {
+    static int bind(sqlite3_stmt* s, int i, double v) { return sqlite3_bind_double(s, i, v); }
+};
+template <> struct Param<std::nullptr_t> {
+    static int bind(sqlite3_stmt* s, int i, std::nullptr_t) { return sqlite3_bind_null(s, i); }
+};
+template <> struct Param<const char*> {
+    static int bind(sqlite3_stmt* s, int i, const char* v) {
+        return v ? sqlite3_bind_text(s, i, v, -1, SQLITE_STATIC) : sqlite3_bind_null(s, i);
+    }
+};
+template <> struct Param<char*> : Param<const char*> {};
+template <> struct Param<std::string_view> {
+    static int bind(sqlite3_stmt* s, int i, std::string_view v) {
+        return sqlite3_bind_text(s, i, v.data(), static_cast<int>(v.size()), SQLITE_STATIC);
+    }
+};
+template <> struct Param<std::string> {
+    // Lvalues outlive the statement step; temporaries are copied by SQLite
+    static int bind(sqlite3_stmt* s, int i, const std::string& v) {
+        return sqlite3_bind_text(s, i, v.data(), static_cast<int>(v.size()), SQLITE_STATIC);
+    }
+    static int bind(sqlite3_stmt* s, int i, std::string&& v) {
+        return sqlite3_bind_text(s, i, v.data(), static_cast<int>(v.size()), SQLITE_TRANSIENT);
+    }
+};
+
+template <typename T, typename = void>
+struct Column {
+    static_assert(Unsupported<T>::value, "type cannot be read from a SQLite column");
+};
+template <> struct Column<int> {
+    static int get(sqlite3_stmt* s, int c) { return sqlite3_column_int(s, c); }
+};
+template <> struct Column<bool> {
+    static bool get(sqlite3_stmt* s, int c) { return sqlite3_column_int(s, c) != 0; }
+};
+template <> struct Column<long long> {
+    static long long get(sqlite3_stmt* s, int c) { return sqlite3_column_int64(s, c); }
+};
+template <> struct Column<double> {
+    static double get(sqlite3_stmt* s, int c) { return sqlite3_column_double(s, c); }
+};
+// Zero-copy view; valid until the next step/reset of the statement
+template <> struct Column<std::string_view> {
+    static std::string_view get(sqlite3_stmt* s, int c) {
+        const unsigned char* t = sqlite3_column_text(s, c);
+        if (!t) return std::string_view();
+        return std::string_view(reinterpret_cast<const char*>(t),
+                                static_cast<size_t>(sqlite3_column_bytes(s, c)));
+    }
+};
+template <> struct Column<std::string> {
+    static std::string get(sqlite3_stmt* s, int c) {
+        return std::string(Column<std::string_view>::get(s, c));
+    }
+};
+
+} // namespace sqlbind
+
+// ----------------------------------------------------------------
+// RAII wrapper for sqlite3_stmt: ensures sqlite3_finalize is called
+// ----------------------------------------------------------------
+struct Stmt {
+    sqlite3_stmt* stmt = nullptr;
+    int           rc   = SQLITE_OK;   // last prepare/step result
+    // Prepare SQL statement or throw on error
+    Stmt(sqlite3* db, const char* sql) {
+        if ((rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr)) != SQLITE_OK) {
+            sqlite3_finalize(stmt);
+            throw std::runtime_error(sqlite3_errmsg(db));
+        }
+    }
+    // Prepare without throwing; check ok() / rc afterwards
+    Stmt(sqlite3* db, const char* sql, std::nothrow_t) noexcept {
+        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    }
+    bool ok() const { return rc == SQLITE_OK && stmt != nullptr; }
+    // Finalize when leaving scope
+    ~Stmt() {
+        sqlite3_finalize(stmt);
+    }
+    Stmt(const Stmt&) = delete;
+    Stmt& operator=(const Stmt&) = delete;
+
+    // Bind every parameter in one call: s.bind(title, author, year)
+    template <typename... Args>
+    Stmt& bind(Args&&... args) {
+        if (static_cast<int>(sizeof...(Args)) != sqlite3_bind_parameter_count(stmt)) {
+            throw std::logic_error("parameter count does not match SQL");
+        }
+        int idx = 0;
+        (bindOne(++idx, std::forward<Args>(args)), ...);
+        return *this;
+    }
+
+    int  step()  { return rc = sqlite3_step(stmt); }
+    bool done()  { return step() == SQLITE_DONE; }
+    void reset() { sqlite3_reset(stmt); sqlite3_clear_bindings(stmt); }
+
+    // Current row as a tuple: auto [id, title] = s.row<int, std::string>();
+    template <typename... Ts>
+    std::tuple<Ts...> row() const {
+        return rowImpl<Ts...>(std::index_sequence_for<Ts...>());
+    }
+
+    // Current row into existing fields: s.into(b.id, b.title, b.year);
+    template <typename... Ts>
+    void into(Ts&... out) const {
+        int col = 0;
+        ((out = sqlbind::Column<Ts>::get(stmt, col++)), ...);
+    }
+
+    // Step through all rows, passing typed columns: s.forEach<int, std::string_view>(fn)
+    template <typename... Ts, typename Fn>
+    void forEach(Fn&& fn) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            std::apply(fn, row<Ts...>());
+        }
+    }
+
+private:
+    template <typename T>
+    void bindOne(int idx, T&& value) {
+        using Base = std::decay_t<T>;
+        if constexpr (std::is_same<Base, std::string>::value) {
+            sqlbind::Param<std::string>::bind(stmt, idx, std::forward<T>(value));
+        } else {
+            sqlbind::Param<Base>::bind(stmt, idx, value);
+        }
+    }
+    template <typename... Ts, size_t... I>
+    std::tuple<Ts...> rowImpl(std::index_sequence<I...>) const {
+        return std::tuple<Ts...>(sqlbind::Column<Ts>::get(stmt, static_cast<int>(I))...);
+    }
+};
+
+#endif // STMT_H
@@ -0,0 +1,147 @@
+// headers/storage.h
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+
+// ----------------------------------------------------------------
+// Plain records shared by every storage engine
+// ----------------------------------------------------------------
+struct Book {
+    int         id       = 0;
+    std::string title;
+    std::string author;
+    std::string isbn;
+    int         year     = 0;
+    int         quantity = 0;
+};
+
+// Dates are day numbers: days since 1970-01-01 (UTC)
+struct Loan {
+    int id        = 0;
+    int userID    = 0;
+    int bookID    = 0;
+    int borrowDay = 0;
+    int returnDay = 0;   // 0 while the loan is open
+};
+
+struct User {
+    int         id = 0;
+    std::string name;
+    std::string role;
+    std::string username;
+    std::string password;
+};
+
+// ----------------------------------------------------------------
+// Repository interfaces
+// ----------------------------------------------------------------
+class BookRepository {
+public:
+    virtual ~BookRepository() = default;
+    virtual int  add(const Book& book) = 0;                 // new id or -1
+    virtual bool update(const Book& book) = 0;
+    virtual bool remove(int bookID) = 0;
+    virtual bool findByID(int bookID, Book& out) = 0;
+    virtual std::vector<Book> list() = 0;
+    // Titles or authors containing keyword, by id; at most limit (0 = all)
+    virtual std::vector<Book> search(const std::string& keyword, size_t limit = 0) = 0;
+    // Every title by one author (name compared after normalizeAuthor,
+    // ignoring ASCII case)
+    virtual std::vector<Book> byAuthor(const std::string& author) = 0;
+    // Apply delta to quantity; fails if the result would be negative
+    virtual bool adjustQuantity(int bookID, int delta) = 0;
+};
+
+class LoanRepository {
+public:
+    virtual ~LoanRepository() = default;
+    virtual int  open(int userID, int bookID, int day) = 0;
+    // Close the most recent open loan of (userID, bookID)
+    virtual bool close(int userID, int bookID, int day) = 0;
+    virtual std::vector<Loan> byUser(int userID) = 0;
+    virtual int  countOverdue(int userID, int today, int loanDays) = 0;
+};
+
+class UserRepository {
+public:
+    virtual ~UserRepository() = default;
+    virtual int  add(const User& user) = 0;                 // new id or -1
+    virtual bool findByID(int userID, User& out) = 0;
+    virtual bool findByUsername(const std::string& username, User& out) = 0;
+};
+
+// ----------------------------------------------------------------
+// A storage engine bundles the three repositories
+// ----------------------------------------------------------------
+class StorageEngine {
+public:
+    virtual ~StorageEngine() = default;
+    virtual const char*     name() const = 0;
+    virtual BookRepository& books() = 0;
+    virtual LoanRepository& loans() = 0;
+    virtual UserRepository& users() = 0;
+    // Write the full contents to a SQLite file at path
+    virtual bool snapshot(const std::string& path) = 0;
+};
+
+// Create the books/users/loans/items tables if missing and migrate
+// older files (PRAGMA user_version) to the current layout
+void createSchema(sqlite3* handle);
+// Give copies to books that have a quantity but no items
+void syncItems(sqlite3* handle);
+// ATTACH path as schema "archive" and create archive.loans if missing
+bool attachArchive(sqlite3* handle, const std::string& path);
+// Recount user_circ.overdue for rows not swept today (nightly job)
+bool sweepOverdue(sqlite3* handle);
+// Copy the main database of from into to with the backup API,
+// pagesPerStep pages per step (everything at once if <= 0), sleeping
+// pauseMs between steps. One read transaction on from spans the copy,
+// so in WAL mode it is a single snapshot that other connections'
+// commits neither block nor restart. Returns the SQLite result code.
+int copyDatabase(sqlite3* from, sqlite3* to, int pagesPerStep, int pauseMs,
+                 int* pages = nullptr, int* steps = nullptr);
+// Fill books.isbn13 from books.isbn where it is missing and valid
+void syncIsbn(sqlite3* handle);
+// Register count new available copies with generated barcodes
+bool addCopies(sqlite3* handle, int bookID, int count);
+// Author names are trimmed and inner whitespace runs collapsed
+std::string normalizeAuthor(const std::string& name);
+// authors.id for name, adding the author if new; 0 on failure
+int internAuthor(sqlite3* handle, const std::string& name);
+
+// SQLite engine on an already-open handle (not owned)
+std::unique_ptr<StorageEngine> makeSqliteStorage(sqlite3* handle);
+
+// In-memory engine; if source is non-null it is preloaded from it
+std::unique_ptr<StorageEngine> makeMemoryStorage(sqlite3* source = nullptr);
+
+// Periodic snapshot of an engine to disk on a background thread
+class SnapshotScheduler {
+public:
+    SnapshotScheduler(StorageEngine& engine, std::string path, int intervalSeconds);
+    ~SnapshotScheduler();
+    SnapshotScheduler(const SnapshotScheduler&) = delete;
+    SnapshotScheduler& operator=(const SnapshotScheduler&) = delete;
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+// ----------------------------------------------------------------
+// Clock and day numbers. Everything that stamps or compares loan
+// dates asks todayDay(), so tests can swap the clock.
+// ----------------------------------------------------------------
+using Clock = long long (*)();     // seconds since 1970-01-01 UTC
+void setClock(Clock clock);        // nullptr restores the system clock
+int  todayDay();
+std::string dayToDate(int day);            // YYYY-MM-DD
+int  dateToDay(const std::string& ymd);    // 0 if malformed
+
+// Today's date as YYYY-MM-DD (UTC)
+std::string todayDate();
+
+#endif // STORAGE_H
@@ -0,0 +1,55 @@
+// headers/string_pool.h
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// ----------------------------------------------------------------
+// String interning pool: each distinct string is stored once and
+// named by a dense id starting at 1, so records can hold an int
+// instead of their own copy. The deque never moves its elements,
+// which keeps the views used as hash keys valid.
+// ----------------------------------------------------------------
+class StringPool {
+public:
+    // Id of s, adding it if new
+    int intern(std::string_view s) {
+        auto it = ids.find(s);
+        if (it != ids.end()) return it->second;
+        strings.emplace_back(s);
+        int id = static_cast<int>(strings.size());
+        ids.emplace(std::string_view(strings.back()), id);
+        textBytes += s.size();
+        return id;
+    }
+
+    // Id of s, or 0 if it was never interned
+    int find(std::string_view s) const {
+        auto it = ids.find(s);
+        return it == ids.end() ? 0 : it->second;
+    }
+
+    // Text of an id returned by intern()
+    const std::string& text(int id) const { return strings[static_cast<size_t>(id - 1)]; }
+
+    size_t size()  const { return strings.size(); }
+    size_t bytes() const { return textBytes; }   // characters stored
+
+    // Visit every entry in id order: fn(id, text)
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        int id = 0;
+        for (const std::string& s : strings) fn(++id, s);
+    }
+
+private:
+    std::deque<std::string>                   strings;
+    std::unordered_map<std::string_view, int> ids;
+    size_t                                    textBytes = 0;
+};
+
+#endif // STRING_POOL_H
@@ -17,7 +17,12 @@ void openDeleteBookWindow();
 void openSearchBookWindow();
 void openViewBookDetailsWindow();
 void openBorrowBookWindow();
+void openCheckoutCartWindow();
 void openReturnBookWindow();
+void openScanModeWindow();
+// Apply the scans still queued and close every scan window; main
+// calls it once the event loop ends
+void closeScanWindows();
 void openViewBorrowHistoryWindow();
 void openCheckOverdueWindow();
 void openRegisterUserWindow();
@@ -0,0 +1,219 @@
+// sources/availability.cpp
+
+#include "availability.h"
+#include "stmt.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+using namespace std;
+
+using SteadyTime = chrono::steady_clock::time_point;
+
+namespace {
+
+struct Source {
+    int        branchID = 0;
+    sqlite3*   conn     = nullptr;
+    long long  version  = -1;   // data_version of the column loaded last
+    SteadyTime checked;
+};
+
+// Great-circle distance on a sphere of the Earth's mean radius
+double distanceKm(const BranchSite& a, const BranchSite& b) {
+    const double rad = 3.14159265358979323846 / 180.0;
+    double dLat = (b.lat - a.lat) * rad;
+    double dLon = (b.lon - a.lon) * rad;
+    double h = sin(dLat / 2) * sin(dLat / 2) +
+               cos(a.lat * rad) * cos(b.lat * rad) * sin(dLon / 2) * sin(dLon / 2);
+    return 2 * 6371.0 * asin(min(1.0, sqrt(h)));
+}
+
+} // namespace
+
+struct AvailabilityIndex::Impl {
+    vector<Source>          sources;   // column i of counts is sources[i]
+    vector<vector<size_t>>  order;     // per column: columns nearest first
+    vector<vector<double>>  km;        // per column: distance to each column, -1 if unknown
+    mutex                   refreshing;
+    atomic<bool>            built{false};   // every open file loaded at least once
+
+    mutable mutex           m;         // guards keys and counts
+    vector<int64_t>         keys;      // sorted
+    vector<uint16_t>        counts;    // keys.size() rows of sources.size()
+
+    size_t column(int branchID) const {
+        for (size_t i = 0; i < sources.size(); ++i)
+            if (sources[i].branchID == branchID) return i;
+        return sources.size();
+    }
+
+    const uint16_t* row(int64_t isbn13) const {
+        auto it = lower_bound(keys.begin(), keys.end(), isbn13);
+        if (it == keys.end() || *it != isbn13) return nullptr;
+        return &counts[static_cast<size_t>(it - keys.begin()) * sources.size()];
+    }
+
+    // rows: (isbn13, available) sorted by isbn13
+    void load(size_t col, const vector<pair<int64_t, int>>& rows) {
+        size_t width = sources.size();
+        lock_guard<mutex> g(m);
+        bool known = all_of(rows.begin(), rows.end(), [this](const pair<int64_t, int>& r) {
+            return binary_search(keys.begin(), keys.end(), r.first);
+        });
+        if (!known) {
+            // New titles: merge the key sets and move the other columns over
+            vector<int64_t> merged;
+            merged.reserve(keys.size() + rows.size());
+            size_t i = 0, j = 0;
+            while (i < keys.size() || j < rows.size()) {
+                if (j == rows.size() || (i < keys.size() && keys[i] < rows[j].first)) {
+                    merged.push_back(keys[i++]);
+                } else {
+                    if (i < keys.size() && keys[i] == rows[j].first) ++i;
+                    merged.push_back(rows[j++].first);
+                }
+            }
+            vector<uint16_t> grown(merged.size() * width, 0);
+            for (size_t k = 0, n = 0; k < keys.size(); ++k) {
+                while (merged[n] != keys[k]) ++n;
+                copy_n(&counts[k * width], width, &grown[n * width]);
+            }
+            keys.swap(merged);
+            counts.swap(grown);
+        }
+        for (size_t k = 0; k < keys.size(); ++k) counts[k * width + col] = 0;
+        size_t k = 0;
+        for (const auto& r : rows) {
+            while (keys[k] != r.first) ++k;
+            counts[k * width + col] = static_cast<uint16_t>(min(max(r.second, 0), 0xffff));
+        }
+    }
+
+    void refreshSource(size_t col, int ttlMs) {
+        Source& s = sources[col];
+        auto now = chrono::steady_clock::now();
+        if (s.version >= 0 && now - s.checked < chrono::milliseconds(ttlMs)) return;
+        s.checked = now;
+        long long version = -1;
+        {
+            Stmt v(s.conn, "PRAGMA data_version;", nothrow);
+            if (v.ok() && v.step() == SQLITE_ROW) version = get<0>(v.row<long long>());
+        }
+        if (version >= 0 && version == s.version) return;
+
+        vector<pair<int64_t, int>> rows;
+        Stmt q(s.conn, "SELECT isbn13, quantity FROM books WHERE isbn13 IS NOT NULL ORDER BY isbn13;", nothrow);
+        if (!q.ok()) return;
+        int rc;
+        while ((rc = q.step()) == SQLITE_ROW) {
+            auto r = q.row<long long, int>();
+            rows.emplace_back(get<0>(r), get<1>(r));
+        }
+        if (rc != SQLITE_DONE) return;   // try again next time
+        load(col, rows);
+        s.version = version;
+    }
+};
+
+AvailabilityIndex::AvailabilityIndex(const vector<Shard>& shards, const vector<BranchSite>& sites)
+    : impl(new Impl)
+{
+    for (const Shard& sh : shards) {
+        Source s;
+        s.branchID = sh.branchID;
+        if (sqlite3_open_v2(sh.path.c_str(), &s.conn, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+            sqlite3_close(s.conn);
+            s.conn = nullptr;
+        } else {
+            sqlite3_busy_timeout(s.conn, 250);
+        }
+        impl->sources.push_back(s);
+    }
+
+    size_t n = impl->sources.size();
+    vector<const BranchSite*> site(n, nullptr);
+    for (const BranchSite& bs : sites) {
+        size_t c = impl->column(bs.branchID);
+        if (c < n) site[c] = &bs;
+    }
+    impl->km.assign(n, vector<double>(n, -1));
+    impl->order.resize(n);
+    for (size_t from = 0; from < n; ++from) {
+        for (size_t to = 0; to < n; ++to) {
+            if (to == from)                  impl->km[from][to] = 0;
+            else if (site[from] && site[to]) impl->km[from][to] = distanceKm(*site[from], *site[to]);
+        }
+        vector<size_t>& o = impl->order[from];
+        for (size_t to = 0; to < n; ++to) o.push_back(to);
+        const vector<double>& d = impl->km[from];
+        stable_sort(o.begin(), o.end(), [&d](size_t a, size_t b) {
+            if ((d[a] < 0) != (d[b] < 0)) return d[b] < 0;   // unknown distances last
+            return d[a] < d[b];
+        });
+    }
+}
+
+AvailabilityIndex::~AvailabilityIndex() {
+    for (Source& s : impl->sources)
+        if (s.conn) sqlite3_close(s.conn);
+}
+
+bool AvailabilityIndex::ok() const {
+    for (const Source& s : impl->sources)
+        if (!s.conn) return false;
+    return true;
+}
+
+void AvailabilityIndex::refresh(int ttlMs) {
+    unique_lock<mutex> r(impl->refreshing, try_to_lock);
+    if (!r.owns_lock()) {
+        if (impl->built) return;   // the last refresh's answers stand
+        r.lock();                  // an empty index would report no copies
+    }
+    bool loaded = true;
+    for (size_t i = 0; i < impl->sources.size(); ++i) {
+        if (!impl->sources[i].conn) continue;
+        impl->refreshSource(i, ttlMs);
+        if (impl->sources[i].version < 0) loaded = false;
+    }
+    if (loaded) impl->built = true;
+}
+
+vector<BranchStock> AvailabilityIndex::stock(int64_t isbn13) const {
+    vector<BranchStock> out;
+    lock_guard<mutex> g(impl->m);
+    const uint16_t* row = impl->row(isbn13);
+    for (size_t i = 0; i < impl->sources.size(); ++i)
+        out.push_back(BranchStock{ impl->sources[i].branchID, row ? row[i] : 0 });
+    return out;
+}
+
+NearestCopy AvailabilityIndex::nearest(int64_t isbn13, int fromBranch) const {
+    NearestCopy out;
+    size_t from = impl->column(fromBranch);
+    if (from == impl->sources.size()) return out;
+    lock_guard<mutex> g(impl->m);
+    const uint16_t* row = impl->row(isbn13);
+    if (!row) return out;
+    for (size_t c : impl->order[from]) {
+        if (!row[c]) continue;
+        out.branchID  = impl->sources[c].branchID;
+        out.available = row[c];
+        out.km        = impl->km[from][c];
+        break;
+    }
+    return out;
+}
+
+size_t AvailabilityIndex::titles() const {
+    lock_guard<mutex> g(impl->m);
+    return impl->keys.size();
+}
+
+size_t AvailabilityIndex::bytes() const {
+    lock_guard<mutex> g(impl->m);
+    return impl->keys.capacity() * sizeof(int64_t) + impl->counts.capacity() * sizeof(uint16_t);
+}
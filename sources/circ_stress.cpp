@@ -0,0 +1,163 @@
+// sources/circ_stress.cpp
+//
+// Multi-process circulation stress: forks worker processes that each
+// open library.db (in the current directory) through the core layer,
+// log in as their own patron and borrow and return random titles as
+// fast as they can. Runs with 1, 2, 4 ... processes and prints the
+// combined throughput, Busy failures and latency for each.
+//
+//   circ_stress [seconds per run] [max processes] [--no-wait]
+//
+// --no-wait sets a zero busy budget and a single attempt, which is how
+// the app behaved before it had a busy handler.
+
+#include "core.h"
+#include "ui.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+void showErrorMessage(const string& message) {
+    cerr << "Error: " << message << endl;
+}
+
+void showSuccessMessage(const string&) {}
+
+static const int titles = 64;   // stress titles, 4 copies each
+
+struct WorkerResult {
+    long   ok    = 0;   // borrow+return pairs completed
+    long   busy  = 0;   // transactions that gave up with Busy
+    long   other = 0;   // any other failure
+    double p50Ms = 0;
+    double p99Ms = 0;
+    double maxMs = 0;
+    long   waits = 0;   // busy-handler sleeps
+};
+
+static string patronName(int i) { return "stress" + to_string(i); }
+
+// Stress patrons and titles, created once
+static bool prepare(int processes) {
+    initializeSystem();
+    if (!getStorage()) return false;
+    for (int i = 0; i < processes; ++i)
+        tryRegisterUser(patronName(i), "student", patronName(i), "stress");   // may exist already
+    setLoginState(true, 1, true);
+    for (int t = 0; t < titles; ++t) {
+        string isbn = "97800000" + string(4 - to_string(t).size(), '0') + to_string(t);
+        long sum = 0;
+        for (int i = 0; i < 12; ++i) sum += (isbn[i] - '0') * (i % 2 ? 3 : 1);
+        isbn += static_cast<char>('0' + (10 - sum % 10) % 10);
+        if (!findBookByIsbn(isbn)) tryAddBook("Stress title " + to_string(t), "Stress Author", isbn, 2024, 4);
+    }
+    logoutUser();
+    closeSystem();
+    return true;
+}
+
+static WorkerResult work(int index, int seconds, bool noWait) {
+    WorkerResult res;
+    initializeSystem();
+    if (noWait) setBusyPolicy(OpClass::Interactive, BusyPolicy{ 0, 1, 0, 0 });
+    if (!tryLoginUser(patronName(index), "stress")) {
+        res.other = 1;
+        return res;
+    }
+    Result<BookList> found = searchBooks("Stress title");
+    if (!found || found.value()->empty()) {
+        res.other = 1;
+        return res;
+    }
+    const vector<Book>& books = *found.value();
+
+    mt19937 rng(static_cast<unsigned>(getpid()));
+    vector<double> latencies;
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(seconds);
+    while (chrono::steady_clock::now() < deadline) {
+        int bookID = books[rng() % books.size()].id;
+        auto start = chrono::steady_clock::now();
+        Status st = tryBorrowBook(bookID);
+        if (st) st = tryReturnBook(bookID);
+        latencies.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+        if (st)                                      ++res.ok;
+        else if (st.code() == ErrorCode::Busy)       ++res.busy;
+        else if (st.code() != ErrorCode::NoCopies)   ++res.other;
+    }
+    sort(latencies.begin(), latencies.end());
+    if (!latencies.empty()) {
+        res.p50Ms = latencies[latencies.size() / 2];
+        res.p99Ms = latencies[latencies.size() * 99 / 100];
+        res.maxMs = latencies.back();
+    }
+    res.waits = static_cast<long>(getContentionStats().handlerWaits);
+    logoutUser();
+    closeSystem();
+    return res;
+}
+
+// One run with n processes; results come back over a pipe
+static void run(int n, int seconds, bool noWait) {
+    int fds[2];
+    if (pipe(fds) != 0) return;
+    vector<pid_t> pids;
+    for (int i = 0; i < n; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            WorkerResult r = work(i, seconds, noWait);
+            ssize_t w = write(fds[1], &r, sizeof r);
+            _exit(w == sizeof r ? 0 : 1);
+        }
+        if (pid > 0) pids.push_back(pid);
+    }
+    close(fds[1]);
+    WorkerResult total;
+    double p99 = 0;
+    WorkerResult r;
+    while (read(fds[0], &r, sizeof r) == sizeof r) {
+        total.ok    += r.ok;
+        total.busy  += r.busy;
+        total.other += r.other;
+        total.waits += r.waits;
+        total.p50Ms  = max(total.p50Ms, r.p50Ms);
+        total.maxMs  = max(total.maxMs, r.maxMs);
+        p99          = max(p99, r.p99Ms);
+    }
+    close(fds[0]);
+    for (pid_t pid : pids) waitpid(pid, nullptr, 0);
+
+    cout << n << (n == 1 ? " process:   " : " processes: ")
+         << static_cast<long>(total.ok / static_cast<double>(seconds)) << " borrow+return/s, "
+         << total.busy << " busy failures, " << total.other << " other, "
+         << "p50 " << total.p50Ms << " ms, p99 " << p99 << " ms, max " << total.maxMs << " ms, "
+         << total.waits << " handler waits" << endl;
+}
+
+int main(int argc, char** argv) {
+    int  seconds  = 5;
+    int  maxProcs = 8;
+    bool noWait   = false;
+    int  pos      = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-wait") == 0) noWait = true;
+        else if (pos++ == 0)                   seconds  = atoi(argv[i]);
+        else                                   maxProcs = atoi(argv[i]);
+    }
+    if (seconds <= 0 || maxProcs <= 0) {
+        cerr << "usage: circ_stress [seconds per run] [max processes] [--no-wait]" << endl;
+        return 2;
+    }
+    if (!prepare(maxProcs)) return 1;
+    for (int n = 1; n <= maxProcs; n *= 2) run(n, seconds, noWait);
+    return 0;
+}
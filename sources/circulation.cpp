@@ -0,0 +1,175 @@
+// sources/circulation.cpp
+
+#include "circulation.h"
+#include "storage.h"
+#include "isbn.h"
+#include <new>
+
+using namespace std;
+
+// Bind, step once, reset; returns the step result
+template <typename... Args>
+static int runOnce(Stmt& s, Args&&... args) {
+    s.bind(forward<Args>(args)...);
+    int rc = s.step();
+    s.reset();
+    return rc;
+}
+
+// Bind, step once and read the first row into out...; returns the step result
+template <typename... Out, typename... Args>
+static int fetchOne(Stmt& s, tuple<Out&...> out, Args&&... args) {
+    s.bind(forward<Args>(args)...);
+    int rc = s.step();
+    if (rc == SQLITE_ROW) {
+        apply([&s](Out&... o) { s.into(o...); }, out);
+    }
+    s.reset();
+    return rc;
+}
+
+Circulation::Circulation(sqlite3* c)
+    : conn(c),
+      byBarcode(c, R"SQL(
+          SELECT book_id, id FROM items WHERE barcode=?1
+          UNION ALL
+          SELECT id, 0 FROM books WHERE isbn13=?2
+          UNION ALL
+          SELECT id, 0 FROM books WHERE isbn=?1      -- legacy ISBNs with no key
+          UNION ALL
+          SELECT id, 0 FROM books WHERE id=?1
+          LIMIT 1;
+      )SQL", nothrow),
+      hasBook(c, "SELECT 1 FROM books WHERE id=?;", nothrow),
+      pickItem(c, "SELECT id FROM items WHERE book_id=? AND status='available' LIMIT 1;", nothrow),
+      itemInfo(c, "SELECT book_id, status='available' FROM items WHERE id=?;", nothrow),
+      takeItem(c, "UPDATE items SET status='on_loan' WHERE id=? AND status='available';", nothrow),
+      openLoan(c, "INSERT INTO loans(user_id,book_id,item_id,borrow_date) VALUES(?,?,?,?);", nothrow),
+      loanOfUser(c, R"SQL(
+          SELECT id, IFNULL(item_id,0) FROM loans
+           WHERE book_id=? AND user_id=? AND return_date IS NULL
+           ORDER BY borrow_date DESC, id DESC LIMIT 1;
+      )SQL", nothrow),
+      loanOfAny(c, R"SQL(
+          SELECT id, IFNULL(item_id,0) FROM loans
+           WHERE book_id=? AND return_date IS NULL
+           ORDER BY borrow_date, id LIMIT 1;
+      )SQL", nothrow),
+      loanOfItem(c, "SELECT id, book_id FROM loans WHERE item_id=? AND return_date IS NULL;", nothrow),
+      closeLoan(c, "UPDATE loans SET return_date=? WHERE id=?;", nothrow),
+      releaseItem(c, "UPDATE items SET status='available' WHERE id=?;", nothrow),
+      bumpQuantity(c, "UPDATE books SET quantity=quantity+1 WHERE id=?;", nothrow),
+      nextHold(c, R"SQL(
+          SELECT id, user_id FROM holds
+           WHERE book_id=? AND status='waiting'
+           ORDER BY priority DESC, id LIMIT 1;
+      )SQL", nothrow),
+      fulfillHold(c, "UPDATE holds SET status='fulfilled', loan_id=? WHERE id=?;", nothrow),
+      openCount(c, "SELECT open_loans FROM user_circ WHERE user_id=?;", nothrow)
+{
+    for (const Stmt* s : { &byBarcode, &hasBook, &pickItem, &itemInfo, &takeItem, &openLoan,
+                           &loanOfUser, &loanOfAny, &loanOfItem, &closeLoan, &releaseItem,
+                           &bumpQuantity, &nextHold, &fulfillHold, &openCount }) {
+        if (!s->ok()) {
+            prepareRC = s->rc;
+            break;
+        }
+    }
+}
+
+ErrorCode Circulation::resolve(const string& barcode, Target& out) {
+    // An invalid ISBN binds 0, which matches no isbn13
+    long long key = normalizeIsbn(barcode);
+    int rc = fetchOne(byBarcode, tie(out.bookID, out.itemID), barcode, key);
+    if (rc == SQLITE_ROW)  return ErrorCode::Ok;
+    if (rc == SQLITE_DONE) return ErrorCode::NotFound;
+    return fromSqlite(rc);
+}
+
+ErrorCode Circulation::findAvailable(int bookID, int& itemID) {
+    int rc = fetchOne(pickItem, tie(itemID), bookID);
+    if (rc == SQLITE_ROW) return ErrorCode::Ok;
+    if (rc != SQLITE_DONE) return fromSqlite(rc);
+    rc = runOnce(hasBook, bookID);
+    if (rc == SQLITE_ROW)  return ErrorCode::NoCopies;
+    if (rc == SQLITE_DONE) return ErrorCode::NotFound;
+    return fromSqlite(rc);
+}
+
+ErrorCode Circulation::checkout(int userID, int bookID, int* itemID) {
+    int picked = 0;
+    ErrorCode code = findAvailable(bookID, picked);
+    if (code != ErrorCode::Ok) return code;
+    code = lend(userID, bookID, picked);
+    if (code == ErrorCode::Ok && itemID) *itemID = picked;
+    return code;
+}
+
+ErrorCode Circulation::checkoutItem(int userID, int itemID) {
+    int bookID = 0;
+    bool available = false;
+    int rc = fetchOne(itemInfo, tie(bookID, available), itemID);
+    if (rc == SQLITE_DONE) return ErrorCode::NotFound;
+    if (rc != SQLITE_ROW)  return fromSqlite(rc);
+    if (!available)        return ErrorCode::NoCopies;
+    return lend(userID, bookID, itemID);
+}
+
+ErrorCode Circulation::lend(int userID, int bookID, int itemID) {
+    if (loanLimit > 0) {
+        int open = 0;
+        int rc = fetchOne(openCount, tie(open), userID);
+        if (rc != SQLITE_ROW && rc != SQLITE_DONE) return fromSqlite(rc);
+        if (open >= loanLimit) return ErrorCode::LoanLimit;
+    }
+    // Conditional on status so a copy can never be lent twice
+    int rc = runOnce(takeItem, itemID);
+    if (rc != SQLITE_DONE) return fromSqlite(rc);
+    if (sqlite3_changes(conn) == 0) return ErrorCode::NoCopies;
+    rc = runOnce(openLoan, userID, bookID, itemID, todayDay());
+    return rc == SQLITE_DONE ? ErrorCode::Ok : fromSqlite(rc);
+}
+
+ErrorCode Circulation::checkin(int bookID, int userID, int* heldFor) {
+    int loanID = 0, itemID = 0;
+    int rc = userID ? fetchOne(loanOfUser, tie(loanID, itemID), bookID, userID)
+                    : fetchOne(loanOfAny, tie(loanID, itemID), bookID);
+    if (rc == SQLITE_DONE) return ErrorCode::NotFound;
+    if (rc != SQLITE_ROW)  return fromSqlite(rc);
+    return close(loanID, itemID, bookID, heldFor);
+}
+
+ErrorCode Circulation::checkinItem(int itemID, int* heldFor) {
+    int loanID = 0, bookID = 0;
+    int rc = fetchOne(loanOfItem, tie(loanID, bookID), itemID);
+    if (rc == SQLITE_DONE) return ErrorCode::NotFound;
+    if (rc != SQLITE_ROW)  return fromSqlite(rc);
+    return close(loanID, itemID, bookID, heldFor);
+}
+
+ErrorCode Circulation::close(int loanID, int itemID, int bookID, int* heldFor) {
+    if (heldFor) *heldFor = 0;
+    int rc = runOnce(closeLoan, todayDay(), loanID);
+    if (rc != SQLITE_DONE) return fromSqlite(rc);
+    // Loans from before copy tracking have no item; count the copy back directly
+    if (!itemID) {
+        rc = runOnce(bumpQuantity, bookID);
+        return rc == SQLITE_DONE ? ErrorCode::Ok : fromSqlite(rc);
+    }
+
+    // Head of the hold queue takes the copy; it never goes back on the shelf
+    int holdID = 0, holdUser = 0;
+    rc = fetchOne(nextHold, tie(holdID, holdUser), bookID);
+    if (rc == SQLITE_DONE) {
+        rc = runOnce(releaseItem, itemID);
+        return rc == SQLITE_DONE ? ErrorCode::Ok : fromSqlite(rc);
+    }
+    if (rc != SQLITE_ROW) return fromSqlite(rc);
+
+    rc = runOnce(openLoan, holdUser, bookID, itemID, todayDay());
+    if (rc != SQLITE_DONE) return fromSqlite(rc);
+    rc = runOnce(fulfillHold, static_cast<long long>(sqlite3_last_insert_rowid(conn)), holdID);
+    if (rc != SQLITE_DONE) return fromSqlite(rc);
+    if (heldFor) *heldFor = holdUser;
+    return ErrorCode::Ok;
+}
@@ -2,36 +2,431 @@
 
 #include "core.h"
 #include "ui.h"
+#include "stmt.h"
+#include "circulation.h"
+#include "isbn.h"
+#include "bloom.h"
+#include "single_flight.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
+#include <mutex>
+#include <new>
+#include <random>
 #include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <sys/stat.h>
 #include <sqlite3.h>
+#include <zlib.h>
 
 using namespace std;
 
 // ----------------------------------------------------------------
-// RAII wrapper for sqlite3_stmt: ensures sqlite3_finalize is called
+// Global state for DB handle and current user
 // ----------------------------------------------------------------
-struct Stmt {
-    sqlite3_stmt* stmt;
-    // Prepare SQL statement or throw on error
-    Stmt(sqlite3* db, const char* sql) {
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-            throw runtime_error(sqlite3_errmsg(db));
-        }
+static sqlite3* db            = nullptr;
+static bool     userLoggedIn  = false;
+static bool     userIsAdmin   = false;
+static int      currentUserID = -1;
+static unique_ptr<StorageEngine> storage;
+static unique_ptr<Circulation>   circ;      // prepared once per session
+static atomic<int> loanLimit{0};            // 0 = unlimited; scan workers read it
+static bool     archiveReady  = false;      // library_archive.db attached
+static unique_ptr<MaintenanceThread> maintenance;
+static mutex                         writerLock;   // guards writers and quietWriters
+static vector<sqlite3*>              writers;      // library.db connections besides db
+static bool                          quietWriters = false;   // autocheckpoint off on them
+static unique_ptr<ReportReplica>     replica;   // reports read here when set
+
+// "Also borrowed" lists in memory; recommendLock guards these three
+static mutex                            recommendLock;
+static shared_ptr<const CoBorrowIndex>  coBorrow;
+static long long                        coBorrowBuild = -1;   // recommendation_builds.id held
+static chrono::steady_clock::time_point coBorrowChecked;
+static mutex                            recommendLoad;        // one reload at a time
+
+// ----------------------------------------------------------------
+// Transaction guard: rolls back unless commit() succeeded.
+// Takes the write lock up front (BEGIN IMMEDIATE) so two writers
+// never both hold a read lock and deadlock on the upgrade.
+// ----------------------------------------------------------------
+namespace {
+struct Transaction {
+    sqlite3* conn   = db;   // a branch file's connection, or library.db
+    bool     active = false;
+    Transaction() = default;
+    explicit Transaction(sqlite3* c) : conn(c) {}
+    Status begin() {
+        int rc = sqlite3_exec(conn, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK) return dbError(conn, rc);
+        active = true;
+        return Status();
+    }
+    Status commit() {
+        int rc = sqlite3_exec(conn, "COMMIT;", nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK) return dbError(conn, rc);
+        active = false;
+        return Status();
     }
-    // Finalize when leaving scope
-    ~Stmt() {
-        sqlite3_finalize(stmt);
+    ~Transaction() {
+        if (active) sqlite3_exec(conn, "ROLLBACK;", nullptr, nullptr, nullptr);
     }
 };
+}
 
 // ----------------------------------------------------------------
-// Global state for DB handle and current user
+// Busy handling. Another process holding the write lock makes SQLite
+// call busyHandler, which sleeps with jittered exponential backoff
+// until the current operation class's wait budget is spent; only then
+// does the statement fail with SQLITE_BUSY. retryOnBusy then reruns
+// the whole transaction, which also covers the cases SQLite reports
+// without consulting the handler. The class is per thread (BusyScope)
+// and defaults to Interactive.
 // ----------------------------------------------------------------
-static sqlite3* db            = nullptr;
-static bool     userLoggedIn  = false;
-static bool     userIsAdmin   = false;
-static int      currentUserID = -1;
+static atomic<uint64_t> statTransactions{0};
+static atomic<uint64_t> statBusyRetries{0};
+static atomic<uint64_t> statBusyFailures{0};
+static atomic<uint64_t> statNoCopies{0};
+static atomic<uint64_t> statWaitMicros{0};
+static atomic<uint64_t> statHandlerWaits{0};
+
+static mutex      policyLock;
+static BusyPolicy policies[] = {
+    //  wait  attempts  base  max (ms)
+    {    250,        4,    1,    4 },   // Interactive: a desk is waiting
+    {   2000,        8,    5,  200 },   // Batch
+    {   5000,        3,   10,  500 },   // Maintenance
+};
+
+static thread_local OpClass                          currentOp = OpClass::Interactive;
+static thread_local chrono::steady_clock::time_point busySince;   // first wait of this lock
+
+namespace {
+// Run the enclosed calls under another operation class
+struct BusyScope {
+    OpClass saved;
+    explicit BusyScope(OpClass op) : saved(currentOp) { currentOp = op; }
+    ~BusyScope() { currentOp = saved; }
+};
+}
+
+BusyPolicy getBusyPolicy(OpClass op) {
+    lock_guard<mutex> g(policyLock);
+    return policies[static_cast<int>(op)];
+}
+
+void setBusyPolicy(OpClass op, const BusyPolicy& policy) {
+    lock_guard<mutex> g(policyLock);
+    policies[static_cast<int>(op)] = policy;
+}
+
+// Random point in the upper half of base * 2^step, capped at maxMs, so
+// contending processes that collided once do not retry in lockstep
+static chrono::microseconds backoff(const BusyPolicy& p, int step) {
+    static thread_local mt19937 rng(random_device{}());
+    long long ceiling = min<long long>(p.maxDelayMs, static_cast<long long>(p.baseDelayMs) << min(step, 20)) * 1000;
+    if (ceiling <= 0) return chrono::microseconds(0);
+    uniform_int_distribution<long long> pick(ceiling / 2, ceiling);
+    return chrono::microseconds(pick(rng));
+}
+
+static int busyHandler(void*, int count) {
+    BusyPolicy p = getBusyPolicy(currentOp);
+    auto now = chrono::steady_clock::now();
+    if (count == 0) busySince = now;
+    chrono::microseconds delay = backoff(p, count);
+    if (now + delay - busySince >= chrono::milliseconds(p.waitBudgetMs)) return 0;
+    ++statHandlerWaits;
+    statWaitMicros += static_cast<uint64_t>(delay.count());
+    this_thread::sleep_for(delay);
+    return 1;
+}
+
+void enableBusyHandling(sqlite3* conn) {
+    sqlite3_busy_handler(conn, busyHandler, nullptr);
+}
+
+// Run txnFn (a whole transaction) again while it fails with Busy
+template <typename Fn>
+static auto retryOnBusy(OpClass op, Fn txnFn) -> decltype(txnFn()) {
+    BusyScope scope(op);
+    BusyPolicy p = getBusyPolicy(op);
+    ++statTransactions;
+    for (int attempt = 1; ; ++attempt) {
+        auto result = txnFn();
+        if (result.code() == ErrorCode::NoCopies) ++statNoCopies;
+        if (result.code() != ErrorCode::Busy) return result;
+        if (attempt >= p.maxAttempts) {
+            ++statBusyFailures;
+            return result;
+        }
+        ++statBusyRetries;
+        chrono::microseconds delay = backoff(p, attempt - 1);
+        statWaitMicros += static_cast<uint64_t>(delay.count());
+        this_thread::sleep_for(delay);
+    }
+}
+
+ContentionStats getContentionStats() {
+    ContentionStats s;
+    s.transactions = statTransactions;
+    s.busyRetries  = statBusyRetries;
+    s.busyFailures = statBusyFailures;
+    s.noCopies     = statNoCopies;
+    s.waitMicros   = statWaitMicros;
+    s.handlerWaits = statHandlerWaits;
+    return s;
+}
+
+void resetContentionStats() {
+    statTransactions = 0;
+    statBusyRetries  = 0;
+    statBusyFailures = 0;
+    statNoCopies     = 0;
+    statWaitMicros   = 0;
+    statHandlerWaits = 0;
+}
+
+static string keyText(int id)            { return to_string(id); }
+static string keyText(const string& code) { return code; }
+
+// Prepare, bind and run a single write statement
+template <typename... Args>
+static Status execWriteOn(sqlite3* conn, const char* sql, Args&&... args) {
+    Stmt stmt(conn, sql, nothrow);
+    if (!stmt.ok()) return dbError(conn, stmt.rc);
+    stmt.bind(forward<Args>(args)...);
+    if (!stmt.done()) return dbError(conn, stmt.rc);
+    return Status();
+}
+
+template <typename... Args>
+static Status execWrite(const char* sql, Args&&... args) {
+    return execWriteOn(db, sql, forward<Args>(args)...);
+}
+
+// ----------------------------------------------------------------
+// Search coalescing and result cache. Concurrent searches for the
+// same normalized keyword run one storage scan (SingleFlight) and
+// share its list; finished lists are kept for searchTtlMs. Catalogue
+// writes on this connection call invalidateSearches(), and commits
+// by other connections change PRAGMA data_version; both bump
+// searchGeneration, which is part of the flight key, so a scan that
+// started before a write is neither joined nor cached afterwards.
+// ----------------------------------------------------------------
+namespace {
+struct CachedSearch {
+    BookList                         books;
+    chrono::steady_clock::time_point expires;
+};
+}
+
+static const size_t searchCacheMax = 512;   // keywords kept at once
+
+static mutex                                searchLock;      // guards the four below
+static unordered_map<string, CachedSearch>  searchCache;
+static uint64_t                             searchGeneration = 0;
+static long long                            searchDataVersion = -1;
+static int                                  searchTtlMs = 2000;
+static SingleFlight<BookList>               searchFlights;
+
+static atomic<uint64_t> statSearches{0};
+static atomic<uint64_t> statSearchScans{0};
+static atomic<uint64_t> statSearchJoined{0};
+static atomic<uint64_t> statSearchHits{0};
+static atomic<uint64_t> statSearchDrops{0};
+
+// Caller holds searchLock
+static void dropSearchesLocked() {
+    ++searchGeneration;
+    if (!searchCache.empty()) ++statSearchDrops;
+    searchCache.clear();
+}
+
+static void invalidateSearches() {
+    lock_guard<mutex> g(searchLock);
+    dropSearchesLocked();
+}
+
+// Caller holds searchLock; notices commits made by other connections
+static void checkDataVersion() {
+    Stmt stmt(db, "PRAGMA data_version;", nothrow);
+    if (!stmt.ok() || stmt.step() != SQLITE_ROW) return;
+    long long version = get<0>(stmt.row<long long>());
+    if (searchDataVersion >= 0 && version != searchDataVersion) dropSearchesLocked();
+    searchDataVersion = version;
+}
+
+// LIKE is ASCII case-insensitive, so folding case keeps the result
+static string searchKey(const string& keyword) {
+    size_t b = keyword.find_first_not_of(" \t");
+    if (b == string::npos) return string();
+    size_t e = keyword.find_last_not_of(" \t");
+    string key = keyword.substr(b, e - b + 1);
+    for (char& c : key) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    return key;
+}
+
+Result<BookList> searchBooks(const string& keyword) {
+    if (!storage) return Error(ErrorCode::Database, "database is not open");
+    ++statSearches;
+    string key = searchKey(keyword);
+    uint64_t generation;
+    {
+        lock_guard<mutex> g(searchLock);
+        checkDataVersion();
+        generation = searchGeneration;
+        auto it = searchCache.find(key);
+        if (it != searchCache.end()) {
+            if (chrono::steady_clock::now() < it->second.expires) {
+                ++statSearchHits;
+                return it->second.books;
+            }
+            searchCache.erase(it);
+        }
+    }
+
+    bool joined = false;
+    BookList books = searchFlights.run(to_string(generation) + ':' + key, [&] {
+        ++statSearchScans;
+        BookList list = make_shared<const vector<Book>>(storage->books().search(key));
+        lock_guard<mutex> g(searchLock);
+        if (searchTtlMs > 0 && generation == searchGeneration) {
+            auto now = chrono::steady_clock::now();
+            if (searchCache.size() >= searchCacheMax) {
+                for (auto it = searchCache.begin(); it != searchCache.end(); ) {
+                    if (it->second.expires <= now) it = searchCache.erase(it);
+                    else                           ++it;
+                }
+                if (searchCache.size() >= searchCacheMax) searchCache.clear();
+            }
+            searchCache[key] = CachedSearch{ list, now + chrono::milliseconds(searchTtlMs) };
+        }
+        return list;
+    }, &joined);
+    if (joined) ++statSearchJoined;
+    return books;
+}
+
+void setSearchCacheTtl(int millis) {
+    lock_guard<mutex> g(searchLock);
+    searchTtlMs = millis > 0 ? millis : 0;
+    searchCache.clear();
+}
+
+SearchStats getSearchStats() {
+    SearchStats s;
+    s.searches      = statSearches;
+    s.scans         = statSearchScans;
+    s.joined        = statSearchJoined;
+    s.cacheHits     = statSearchHits;
+    s.invalidations = statSearchDrops;
+    return s;
+}
+
+void resetSearchStats() {
+    statSearches     = 0;
+    statSearchScans  = 0;
+    statSearchJoined = 0;
+    statSearchHits   = 0;
+    statSearchDrops  = 0;
+}
+
+// ----------------------------------------------------------------
+// Branch files: each has its own connection, storage and prepared
+// circulation statements, like library.db. The list only grows while
+// the system is open, so a BranchShard* stays valid until closeSystem.
+// ----------------------------------------------------------------
+namespace {
+struct BranchShard {
+    Branch                    info;
+    sqlite3*                  conn = nullptr;
+    unique_ptr<StorageEngine> storage;
+    unique_ptr<Circulation>   circ;
+    unique_ptr<MaintenanceThread> maintenance;   // while startMaintenance is in effect
+    ~BranchShard() {
+        maintenance.reset();
+        circ.reset();
+        storage.reset();
+        if (conn) sqlite3_close(conn);
+    }
+};
+}
+
+static mutex                           branchLock;   // guards the five below
+static vector<unique_ptr<BranchShard>> branchShards;
+static shared_ptr<FederatedSearch>     federation;   // built on first search
+static shared_ptr<AvailabilityIndex>   stockIndex;   // built on first lookup
+static bool                            branchUpkeep = false;   // startMaintenance in effect
+static MaintenanceConfig               branchUpkeepConfig;
+static atomic<int>                     stockTtlMs{2000};
+
+static unique_ptr<BranchShard> openBranch(const Branch& info) {
+    unique_ptr<BranchShard> shard(new BranchShard);
+    shard->info = info;
+    if (sqlite3_open(info.path.c_str(), &shard->conn) != SQLITE_OK) return nullptr;
+    enableBusyHandling(shard->conn);
+    sqlite3_exec(shard->conn, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
+    createSchema(shard->conn);
+    shard->storage = makeSqliteStorage(shard->conn);
+    shard->circ.reset(new Circulation(shard->conn));
+    if (!shard->circ->ok()) return nullptr;
+    shard->circ->setLoanLimit(loanLimit);
+    return shard;
+}
+
+// Caller holds branchLock. Each file gets a thread of its own, as
+// library.db does, and its desk connection stops checkpointing inline
+static void startBranchMaintenance(BranchShard& shard) {
+    unique_ptr<MaintenanceThread> m(new MaintenanceThread(shard.info.path, branchUpkeepConfig));
+    if (!m->ok()) {
+        showErrorMessage("Cannot open branch " + shard.info.name + " for maintenance: " + shard.info.path);
+        return;
+    }
+    sqlite3_wal_autocheckpoint(shard.conn, 0);
+    shard.maintenance = move(m);
+}
+
+// Caller holds branchLock
+static void stopBranchMaintenance(BranchShard& shard) {
+    if (!shard.maintenance) return;
+    shard.maintenance.reset();
+    sqlite3_wal_autocheckpoint(shard.conn, 1000);   // SQLite's default
+}
+
+static void openBranches() {
+    vector<Branch> rows;
+    Stmt stmt(db, "SELECT id,name,path FROM branches ORDER BY id;", nothrow);
+    if (!stmt.ok()) return;
+    while (stmt.step() == SQLITE_ROW) {
+        Branch b;
+        stmt.into(b.id, b.name, b.path);
+        rows.push_back(move(b));
+    }
+    lock_guard<mutex> g(branchLock);
+    for (const Branch& b : rows) {
+        unique_ptr<BranchShard> shard = openBranch(b);
+        if (shard) branchShards.push_back(move(shard));
+        else       showErrorMessage("Failed to open branch " + b.name + ": " + b.path);
+    }
+}
+
+static BranchShard* findBranch(int branchID) {
+    lock_guard<mutex> g(branchLock);
+    for (auto& s : branchShards)
+        if (s->info.id == branchID) return s.get();
+    return nullptr;
+}
+
+// library.db for Main
+static sqlite3* branchConnection(int branchID) {
+    if (branchID == 1) return db;
+    BranchShard* shard = findBranch(branchID);
+    return shard ? shard->conn : nullptr;
+}
 
 // ----------------------------------------------------------------
 // Open (or create) library.db and its tables
@@ -41,50 +436,197 @@ void initializeSystem() {
         showErrorMessage("Failed to open database: " + string(sqlite3_errmsg(db)));
         return;
     }
-    // Create books table
-    const char* books_sql = R"SQL(
-        CREATE TABLE IF NOT EXISTS books (
-            id       INTEGER PRIMARY KEY AUTOINCREMENT,
-            title    TEXT    NOT NULL,
-            author   TEXT    NOT NULL,
-            isbn     TEXT    UNIQUE NOT NULL,
-            year     INTEGER,
-            quantity INTEGER
-        );
-    )SQL";
-    sqlite3_exec(db, books_sql, nullptr, nullptr, nullptr);
-
-    // Create users table
-    const char* users_sql = R"SQL(
-        CREATE TABLE IF NOT EXISTS users (
-            id       INTEGER PRIMARY KEY AUTOINCREMENT,
-            name     TEXT    NOT NULL,
-            role     TEXT    CHECK(role IN ('admin','student')) NOT NULL,
-            username TEXT    UNIQUE NOT NULL,
-            password TEXT    NOT NULL
-        );
-    )SQL";
-    sqlite3_exec(db, users_sql, nullptr, nullptr, nullptr);
-
-    // Create loans table
-    const char* loans_sql = R"SQL(
-        CREATE TABLE IF NOT EXISTS loans (
-            id          INTEGER PRIMARY KEY AUTOINCREMENT,
-            user_id     INTEGER NOT NULL,
-            book_id     INTEGER NOT NULL,
-            borrow_date TEXT    NOT NULL,
-            return_date TEXT,
-            FOREIGN KEY(user_id) REFERENCES users(id),
-            FOREIGN KEY(book_id) REFERENCES books(id)
-        );
-    )SQL";
-    sqlite3_exec(db, loans_sql, nullptr, nullptr, nullptr);
+    enableBusyHandling(db);
+    // WAL: readers and the writer do not block each other, so other
+    // app instances only contend when two of them write at once
+    sqlite3_exec(db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
+    createSchema(db);
+    archiveReady = attachArchive(db, "library_archive.db");
+    storage = makeSqliteStorage(db);
+    circ.reset(new Circulation(db));
+    if (!circ->ok()) {
+        showErrorMessage("Failed to prepare circulation statements: " + string(sqlite3_errmsg(db)));
+        circ.reset();
+        return;
+    }
+    circ->setLoanLimit(loanLimit);
+    openBranches();
+    completeTransfers();
+}
+
+// ----------------------------------------------------------------
+// Background maintenance: the thread checkpoints on its own
+// connection, so commits on db and on every registered writer stop
+// checkpointing inline
+// ----------------------------------------------------------------
+// 0 turns automatic checkpoints off; 1000 is SQLite's default
+static void setWriterCheckpoints(bool quiet) {
+    int frames = quiet ? 0 : 1000;
+    lock_guard<mutex> g(writerLock);
+    quietWriters = quiet;
+    if (db) sqlite3_wal_autocheckpoint(db, frames);
+    for (sqlite3* conn : writers) sqlite3_wal_autocheckpoint(conn, frames);
+}
+
+void addWriterConnection(sqlite3* conn) {
+    lock_guard<mutex> g(writerLock);
+    writers.push_back(conn);
+    if (quietWriters) sqlite3_wal_autocheckpoint(conn, 0);
+}
+
+void removeWriterConnection(sqlite3* conn) {
+    lock_guard<mutex> g(writerLock);
+    writers.erase(remove(writers.begin(), writers.end(), conn), writers.end());
+}
+
+Status startMaintenance(const MaintenanceConfig& config) {
+    if (!db) return Error(ErrorCode::Database, "database is not open");
+    stopMaintenance();
+    unique_ptr<MaintenanceThread> m(new MaintenanceThread(getDBPath(), config));
+    if (!m->ok()) return Error(ErrorCode::Database, "cannot open " + getDBPath() + " for maintenance");
+    setWriterCheckpoints(true);
+    maintenance = move(m);
+
+    lock_guard<mutex> g(branchLock);
+    branchUpkeep       = true;
+    branchUpkeepConfig = config;
+    for (auto& s : branchShards) startBranchMaintenance(*s);
+    return Status();
+}
+
+void stopMaintenance() {
+    if (!maintenance) return;
+    {
+        lock_guard<mutex> g(branchLock);
+        branchUpkeep = false;
+        for (auto& s : branchShards) stopBranchMaintenance(*s);
+    }
+    maintenance.reset();
+    setWriterCheckpoints(false);
+}
+
+MaintenanceStats getMaintenanceStats() {
+    return maintenance ? maintenance->stats() : MaintenanceStats();
+}
+
+MaintenanceStats getBranchMaintenanceStats(int branchID) {
+    if (branchID == 1) return getMaintenanceStats();
+    lock_guard<mutex> g(branchLock);
+    for (auto& s : branchShards)
+        if (s->info.id == branchID && s->maintenance) return s->maintenance->stats();
+    return MaintenanceStats();
+}
+
+// ----------------------------------------------------------------
+// Reports: aggregates over loans, routed to the replica when one runs
+// ----------------------------------------------------------------
+Status startReporting(const ReplicaConfig& config) {
+    if (!db) return Error(ErrorCode::Database, "database is not open");
+    stopReporting();
+    unique_ptr<ReportReplica> r(new ReportReplica(getDBPath(), config));
+    if (!r->ok()) return Error(ErrorCode::Database, "cannot copy " + getDBPath() + " for reports");
+    replica = move(r);
+    return Status();
+}
+
+void stopReporting() {
+    replica.reset();
+}
+
+ReplicaStats getReplicaStats() {
+    return replica ? replica->stats() : ReplicaStats();
+}
+
+// The live handle is not owned; a replica copy stays open while held
+static shared_ptr<sqlite3> reportConnection() {
+    if (replica) return replica->connection();
+    return shared_ptr<sqlite3>(db, [](sqlite3*) {});
+}
+
+Result<vector<TitleCount>> reportTopTitles(int days, int limit) {
+    shared_ptr<sqlite3> conn = reportConnection();
+    if (!conn) return Error(ErrorCode::Database, "database is not open");
+    Stmt stmt(conn.get(), R"SQL(
+        SELECT b.id, b.title, a.name, t.n
+          FROM (SELECT book_id, COUNT(*) AS n FROM loans
+                 WHERE borrow_date > ? GROUP BY book_id
+                 ORDER BY n DESC, book_id LIMIT ?) t
+          JOIN books b ON b.id=t.book_id
+          JOIN authors a ON a.id=b.author_id
+         ORDER BY t.n DESC, b.id;
+    )SQL", nothrow);
+    if (!stmt.ok()) return dbError(conn.get(), stmt.rc);
+    stmt.bind(todayDay() - days, limit);
+    vector<TitleCount> out;
+    int rc;
+    while ((rc = stmt.step()) == SQLITE_ROW) {
+        TitleCount t;
+        stmt.into(t.bookID, t.title, t.author, t.loans);
+        out.push_back(move(t));
+    }
+    if (rc != SQLITE_DONE) return dbError(conn.get(), rc);
+    return out;
+}
+
+Result<vector<DayCount>> reportDailyCirculation(int days) {
+    shared_ptr<sqlite3> conn = reportConnection();
+    if (!conn) return Error(ErrorCode::Database, "database is not open");
+    Stmt stmt(conn.get(), R"SQL(
+        SELECT day, SUM(out), SUM(back) FROM (
+            SELECT borrow_date AS day, 1 AS out, 0 AS back FROM loans WHERE borrow_date > ?1
+            UNION ALL
+            SELECT return_date, 0, 1 FROM loans WHERE return_date > ?1
+        ) GROUP BY day ORDER BY day;
+    )SQL", nothrow);
+    if (!stmt.ok()) return dbError(conn.get(), stmt.rc);
+    stmt.bind(todayDay() - days);
+    vector<DayCount> out;
+    int rc;
+    while ((rc = stmt.step()) == SQLITE_ROW) {
+        DayCount d;
+        stmt.into(d.day, d.borrowed, d.returned);
+        out.push_back(d);
+    }
+    if (rc != SQLITE_DONE) return dbError(conn.get(), rc);
+    return out;
+}
+
+int getLoanLimit() {
+    return loanLimit;
+}
+
+void setLoanLimit(int maxOpen) {
+    loanLimit = maxOpen;
+    if (circ) circ->setLoanLimit(maxOpen);
+    lock_guard<mutex> g(branchLock);
+    for (auto& s : branchShards) s->circ->setLoanLimit(maxOpen);
 }
 
 // ----------------------------------------------------------------
 // Close the SQLite database when the program exits
 // ----------------------------------------------------------------
 void closeSystem() {
+    stopMaintenance();
+    stopReporting();
+    {
+        lock_guard<mutex> g(searchLock);
+        dropSearchesLocked();
+        searchDataVersion = -1;
+    }
+    {
+        lock_guard<mutex> g(recommendLock);
+        coBorrow.reset();
+        coBorrowBuild = -1;
+    }
+    {
+        lock_guard<mutex> g(branchLock);
+        federation.reset();   // a search in flight keeps its own reference
+        stockIndex.reset();
+        branchShards.clear();
+    }
+    archiveReady = false;
+    circ.reset();
+    storage.reset();
     if (db) {
         sqlite3_close(db);
         db = nullptr;
@@ -94,30 +636,29 @@ void closeSystem() {
 // ----------------------------------------------------------------
 // Attempt login: if success, set global state and show message
 // ----------------------------------------------------------------
-void loginUser(const string& username, const string& password) {
-	 const char* sql = "SELECT id, role FROM users WHERE username = ? AND password = ?;";
-	    sqlite3_stmt* stmt;
-
-	    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-	        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
-	        sqlite3_bind_text(stmt, 2, password.c_str(), -1, SQLITE_STATIC);
-
-	        if (sqlite3_step(stmt) == SQLITE_ROW) {
-
-	            currentUserID = sqlite3_column_int(stmt, 0);
-	            string role = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-	            userIsAdmin = (role == "admin");
-	            userLoggedIn = true;
-	            // showSuccessMessage("Login successful.");
-	        } else {
-
-	            showErrorMessage("Login failed: Invalid credentials.");
-	        }
-	        sqlite3_finalize(stmt);
-	    } else {
+Status tryLoginUser(const string& username, const string& password) {
+    const char* sql = "SELECT id, role FROM users WHERE username = ? AND password = ?;";
+    Stmt stmt(db, sql, nothrow);
+    if (!stmt.ok()) return dbError(db, stmt.rc);
+    stmt.bind(username, password);
+    int rc = stmt.step();
+    if (rc == SQLITE_DONE) return Error(ErrorCode::NotFound, "invalid credentials");
+    if (rc != SQLITE_ROW)  return dbError(db, rc);
+    auto [id, role] = stmt.row<int, string_view>();
+    currentUserID = id;
+    userIsAdmin   = (role == "admin");
+    userLoggedIn  = true;
+    return Status();
+}
 
-	        showErrorMessage("Failed to prepare login statement.");
-	    }
+void loginUser(const string& username, const string& password) {
+    Status st = tryLoginUser(username, password);
+    if (st.code() == ErrorCode::NotFound) {
+        showErrorMessage("Login failed: Invalid credentials.");
+    } else if (!st) {
+        showErrorMessage("Failed to prepare login statement.");
+    }
+    // else showSuccessMessage("Login successful.");
 }
 
 // ----------------------------------------------------------------
@@ -136,6 +677,11 @@ bool isUserLoggedIn() { return userLoggedIn; }
 bool isUserAdmin()    { return userIsAdmin;    }
 int  getCurrentUserID(){ return currentUserID;  }
 sqlite3* getDB()      { return db;             }
+string getDBPath() {
+    const char* path = db ? sqlite3_db_filename(db, "main") : nullptr;
+    return path ? path : "library.db";
+}
+StorageEngine* getStorage() { return storage.get(); }
 
 // ----------------------------------------------------------------
 // Set login state manually (for testing)
@@ -149,79 +695,231 @@ void setLoginState(bool success, int userID, bool admin) {
 // ----------------------------------------------------------------
 // Add a new book record
 // ----------------------------------------------------------------
+// On library.db or a branch file
+static Status insertBook(sqlite3* conn, const string& title, const string& author,
+                         const string& isbn, int year, int quantity)
+{
+    long long key = normalizeIsbn(isbn);
+    if (!key) return Error(ErrorCode::Constraint, "invalid ISBN " + isbn);
+
+    Transaction txn(conn);
+    Status st = txn.begin();
+    if (!st) return st;
+    int authorID = internAuthor(conn, author);
+    if (!authorID) return dbError(conn, sqlite3_errcode(conn));
+    // quantity starts at 0; the item triggers count each new copy
+    st = execWriteOn(conn, "INSERT INTO books(title,author_id,isbn,isbn13,year,quantity)"
+                           " VALUES(?,?,?,?,?,0);",
+                     title, authorID, isbnText(key), key, year);
+    if (!st) return st;
+    if (!addCopies(conn, static_cast<int>(sqlite3_last_insert_rowid(conn)), quantity))
+        return dbError(conn, sqlite3_errcode(conn));
+    return txn.commit();
+}
+
+Status tryAddBook(const string& title, const string& author,
+                  const string& isbn,  int year,     int quantity)
+{
+    Status st = insertBook(db, title, author, isbn, year, quantity);
+    if (st) invalidateSearches();
+    return st;
+}
+
 bool addBook(const string& title, const string& author,
              const string& isbn,  int year,     int quantity)
 {
-    const char* sql = "INSERT INTO books(title,author,isbn,year,quantity)"
-                      " VALUES(?,?,?,?,?);";
-    try {
-        Stmt stmt(db, sql);
-        sqlite3_bind_text(stmt.stmt, 1, title.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt.stmt, 2, author.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt.stmt, 3, isbn.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt.stmt, 4, year);
-        sqlite3_bind_int(stmt.stmt, 5, quantity);
-        if (sqlite3_step(stmt.stmt) != SQLITE_DONE) {
-            throw runtime_error(sqlite3_errmsg(db));
+    Status st = tryAddBook(title, author, isbn, year, quantity);
+    if (!st) showErrorMessage("Add book failed: " + st.error().message());
+    return st.ok();
+}
+
+// ----------------------------------------------------------------
+// Bulk import. A Bloom filter of the ISBN keys already in books is
+// built by one scan of the isbn13 index; records it rules out are
+// inserted without a lookup, and only the ones it flags are checked
+// exactly. A rolled-back batch leaves extra keys in the filter, which
+// only costs extra exact checks.
+// ----------------------------------------------------------------
+ImportResult importBooks(const vector<Book>& rows, size_t batchSize) {
+    BusyScope scope(OpClass::Batch);
+    ImportResult res;
+    auto start = chrono::steady_clock::now();
+    if (batchSize == 0) batchSize = 1;
+
+    vector<string> isbns;
+    isbns.reserve(rows.size());
+    for (const Book& b : rows) isbns.push_back(b.isbn);
+    vector<int64_t> keys;
+    normalizeIsbns(isbns, keys);
+
+    Stmt existing(db, "SELECT COUNT(*) FROM books WHERE isbn13 IS NOT NULL;", nothrow);
+    Stmt scan(db, "SELECT isbn13 FROM books WHERE isbn13 IS NOT NULL;", nothrow);
+    Stmt exact(db, "SELECT 1 FROM books WHERE isbn13=?;", nothrow);
+    Stmt insert(db, "INSERT INTO books(title,author_id,isbn,isbn13,year,quantity) VALUES(?,?,?,?,?,0);",
+                nothrow);
+    for (const Stmt* s : { &existing, &scan, &exact, &insert }) {
+        if (!s->ok()) {
+            res.status = dbError(db, s->rc);
+            return res;
+        }
+    }
+    size_t known = existing.step() == SQLITE_ROW ? static_cast<size_t>(get<0>(existing.row<long long>())) : 0;
+    BloomFilter seen(known + rows.size(), 0.01);
+    scan.forEach<long long>([&seen](long long key) { seen.add(static_cast<uint64_t>(key)); });
+    // Author ids by name as given; a failed batch ends the import, so
+    // ids from a rolled-back batch are never reused
+    unordered_map<string, int> authorIDs;
+
+    for (size_t pos = 0; pos < rows.size() && res.status; ) {
+        size_t end = min(rows.size(), pos + batchSize);
+        Transaction txn;
+        res.status = txn.begin();
+        if (!res.status) break;
+        int batchImported = 0, batchFp = 0;
+        for (; pos < end; ++pos) {
+            const Book& b = rows[pos];
+            long long key = keys[pos];
+            if (!key) {
+                ++res.invalid;
+                continue;
+            }
+            bool flagged = seen.mayContain(static_cast<uint64_t>(key));
+            if (flagged) {
+                ++res.probes;
+                exact.bind(key);
+                int rc = exact.step();
+                exact.reset();
+                if (rc == SQLITE_ROW) {
+                    ++res.duplicates;
+                    continue;
+                }
+                if (rc != SQLITE_DONE) {
+                    res.status = dbError(db, rc);
+                    break;
+                }
+                ++batchFp;
+            }
+            int& authorID = authorIDs[b.author];
+            if (!authorID) authorID = internAuthor(db, b.author);
+            if (!authorID) {
+                res.status = dbError(db, sqlite3_errcode(db));
+                break;
+            }
+            insert.bind(b.title, authorID, isbnText(key), key, b.year);
+            bool ok = insert.done();
+            insert.reset();
+            if (!ok || !addCopies(db, static_cast<int>(sqlite3_last_insert_rowid(db)), b.quantity)) {
+                res.status = dbError(db, sqlite3_errcode(db));
+                break;
+            }
+            seen.add(static_cast<uint64_t>(key));
+            ++batchImported;
+        }
+        if (res.status) res.status = txn.commit();
+        if (res.status && batchImported) invalidateSearches();
+        if (res.status) {
+            res.imported       += batchImported;
+            res.falsePositives += batchFp;
         }
-        return true;
-    } catch (const exception& ex) {
-        showErrorMessage(string("Add book failed: ") + ex.what());
-        return false;
     }
+    res.expectedFpRate = seen.expectedFpRate();
+    res.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return res;
+}
+
+// ----------------------------------------------------------------
+// Look a book up by ISBN-10 or ISBN-13 through the isbn13 index
+// ----------------------------------------------------------------
+Result<Book> findBookByIsbn(const string& isbn) {
+    long long key = normalizeIsbn(isbn);
+    if (!key) return Error(ErrorCode::NotFound, "invalid ISBN " + isbn);
+    Stmt stmt(db, "SELECT b.id,b.title,a.name,b.isbn,b.year,b.quantity FROM books b "
+                  "JOIN authors a ON a.id=b.author_id WHERE b.isbn13=?;", nothrow);
+    if (!stmt.ok()) return dbError(db, stmt.rc);
+    stmt.bind(key);
+    int rc = stmt.step();
+    if (rc == SQLITE_DONE) return ErrorCode::NotFound;
+    if (rc != SQLITE_ROW)  return dbError(db, rc);
+    Book b;
+    stmt.into(b.id, b.title, b.author, b.isbn, b.year, b.quantity);
+    return b;
 }
 
 // ----------------------------------------------------------------
 // Edit an existing book's title/author
 // ----------------------------------------------------------------
+Status tryEditBook(int bookID, const string& newTitle, const string& newAuthor) {
+    Transaction txn;
+    Status st = txn.begin();
+    if (!st) return st;
+    int authorID = internAuthor(db, newAuthor);
+    if (!authorID) return dbError(db, sqlite3_errcode(db));
+    st = execWrite("UPDATE books SET title=?,author_id=? WHERE id=?;",
+                   newTitle, authorID, bookID);
+    if (!st) return st;
+    if (sqlite3_changes(db) == 0) return Error(ErrorCode::NotFound, "no book with that ID");
+    st = txn.commit();
+    if (st) invalidateSearches();
+    return st;
+}
+
 bool editBook(int bookID, const string& newTitle, const string& newAuthor) {
-    const char* sql = "UPDATE books SET title=?,author=? WHERE id=?;";
-    try {
-        Stmt stmt(db, sql);
-        sqlite3_bind_text(stmt.stmt, 1, newTitle.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt.stmt, 2, newAuthor.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt.stmt, 3, bookID);
-        if (sqlite3_step(stmt.stmt) != SQLITE_DONE) {
-            throw runtime_error(sqlite3_errmsg(db));
-        }
-        return true;
-    } catch (const exception& ex) {
-        showErrorMessage(string("Edit book failed: ") + ex.what());
-        return false;
-    }
+    Status st = tryEditBook(bookID, newTitle, newAuthor);
+    if (!st) showErrorMessage("Edit book failed: " + st.error().message());
+    return st.ok();
 }
 
 // ----------------------------------------------------------------
 // Delete a book by ID
 // ----------------------------------------------------------------
+Status tryDeleteBook(int bookID) {
+    Transaction txn;
+    Status st = txn.begin();
+    if (!st) return st;
+    // A copy on loan keeps its item row until it comes back, and
+    // deliverTransfers reads the title from books until the receiving
+    // branch has every copy sent
+    Stmt busy(db, R"SQL(
+        SELECT EXISTS (SELECT 1 FROM loans WHERE book_id=?1 AND return_date IS NULL),
+               EXISTS (SELECT 1 FROM transfers t JOIN books b ON b.isbn13=t.isbn13
+                        WHERE b.id=?1 AND t.received IS NULL);
+    )SQL", nothrow);
+    if (!busy.ok()) return dbError(db, busy.rc);
+    busy.bind(bookID);
+    if (busy.step() != SQLITE_ROW) return dbError(db, busy.rc);
+    auto [onLoan, inTransit] = busy.row<int, int>();
+    if (onLoan)    return Error(ErrorCode::Constraint, "copies are on loan; delete after they are returned");
+    if (inTransit) return Error(ErrorCode::Constraint, "copies are in transit to another branch");
+    st = execWrite("DELETE FROM items WHERE book_id=?;", bookID);
+    if (!st) return st;
+    st = execWrite("DELETE FROM books WHERE id=?;", bookID);
+    if (!st) return st;
+    if (sqlite3_changes(db) == 0) return Error(ErrorCode::NotFound, "no book with that ID");
+    st = txn.commit();
+    if (st) invalidateSearches();
+    return st;
+}
+
 bool deleteBook(int bookID) {
-    const char* sql = "DELETE FROM books WHERE id=?;";
-    try {
-        Stmt stmt(db, sql);
-        sqlite3_bind_int(stmt.stmt, 1, bookID);
-        if (sqlite3_step(stmt.stmt) != SQLITE_DONE) {
-            throw runtime_error(sqlite3_errmsg(db));
-        }
-        return true;
-    } catch (const exception& ex) {
-        showErrorMessage(string("Delete book failed: ") + ex.what());
-        return false;
-    }
+    Status st = tryDeleteBook(bookID);
+    if (!st) showErrorMessage("Delete book failed: " + st.error().message());
+    return st.ok();
 }
 
 // ----------------------------------------------------------------
 // List all books on console
 // ----------------------------------------------------------------
 void fetchBookList() {
-    const char* sql = "SELECT id,title,author FROM books;";
+    const char* sql = "SELECT b.id,b.title,a.name FROM books b "
+                      "JOIN authors a ON a.id=b.author_id;";
     try {
         Stmt stmt(db, sql);
-        while (sqlite3_step(stmt.stmt) == SQLITE_ROW) {
-            cout << "ID: " << sqlite3_column_int(stmt.stmt,0)
-                 << ", Title: " << sqlite3_column_text(stmt.stmt,1)
-                 << ", Author: " << sqlite3_column_text(stmt.stmt,2)
+        stmt.forEach<int, string_view, string_view>([](int id, string_view title, string_view author) {
+            cout << "ID: " << id
+                 << ", Title: " << title
+                 << ", Author: " << author
                  << endl;
-        }
+        });
     } catch (...) {
         showErrorMessage("Failed to fetch book list.");
     }
@@ -231,21 +929,24 @@ void fetchBookList() {
 // Show detailed info for one book
 // ----------------------------------------------------------------
 void fetchBookDetailsByID(int bookID) {
-    const char* sql = "SELECT title,author,isbn,year,quantity FROM books WHERE id=?;";
-    try {
-        Stmt stmt(db, sql);
-        sqlite3_bind_int(stmt.stmt,1,bookID);
-        if (sqlite3_step(stmt.stmt) == SQLITE_ROW) {
-            cout << "Title: "    << sqlite3_column_text(stmt.stmt,0) << endl;
-            cout << "Author: "   << sqlite3_column_text(stmt.stmt,1) << endl;
-            cout << "ISBN: "     << sqlite3_column_text(stmt.stmt,2) << endl;
-            cout << "Year: "     << sqlite3_column_int(stmt.stmt,3)  << endl;
-            cout << "Quantity: " << sqlite3_column_int(stmt.stmt,4)  << endl;
-        } else {
-            showErrorMessage("Book not found.");
-        }
-    } catch (...) {
+    Result<BookDetails> r = fetchBookDetails(bookID);
+    if (r.code() == ErrorCode::NotFound) {
+        showErrorMessage("Book not found.");
+        return;
+    }
+    if (!r) {
         showErrorMessage("Failed to fetch book details.");
+        return;
+    }
+    const BookDetails& d = r.value();
+    cout << "Title: "    << d.book.title    << endl;
+    cout << "Author: "   << d.book.author   << endl;
+    cout << "ISBN: "     << d.book.isbn     << endl;
+    cout << "Year: "     << d.book.year     << endl;
+    cout << "Quantity: " << d.book.quantity << endl;
+    if (!d.alsoBorrowed.empty()) {
+        cout << "Patrons who borrowed this also borrowed:" << endl;
+        for (const Book& b : d.alsoBorrowed) cout << "  " << b.title << " / " << b.author << endl;
     }
 }
 
@@ -253,176 +954,1141 @@ void fetchBookDetailsByID(int bookID) {
 // Search books by title or author keyword
 // ----------------------------------------------------------------
 void searchBookByKeyword(const string& keyword) {
-    const char* sql = "SELECT id,title,author FROM books "
-                      "WHERE title LIKE ? OR author LIKE ?;";
-    try {
-        Stmt stmt(db, sql);
-        string pat = "%" + keyword + "%";
-        sqlite3_bind_text(stmt.stmt,1,pat.c_str(),-1,SQLITE_STATIC);
-        sqlite3_bind_text(stmt.stmt,2,pat.c_str(),-1,SQLITE_STATIC);
-        while (sqlite3_step(stmt.stmt) == SQLITE_ROW) {
-            cout << "ID: " << sqlite3_column_int(stmt.stmt,0)
-                 << ", Title: " << sqlite3_column_text(stmt.stmt,1)
-                 << ", Author: " << sqlite3_column_text(stmt.stmt,2)
-                 << endl;
-        }
-    } catch (...) {
-        showErrorMessage("Search failed.");
+    Result<BookList> r = searchBooks(keyword);
+    if (!r) {
+        showErrorMessage("Search failed: " + r.error().message());
+        return;
+    }
+    for (const Book& b : *r.value()) {
+        cout << "ID: " << b.id
+             << ", Title: " << b.title
+             << ", Author: " << b.author
+             << endl;
     }
 }
 
 // ----------------------------------------------------------------
-// Borrow a book within a transaction: decrement qty + insert loan
+// Authors: one row per name in authors, so "all books by" is a
+// unique-index lookup plus idx_books_author instead of a LIKE scan
 // ----------------------------------------------------------------
+Result<Author> findAuthor(const string& name) {
+    Stmt stmt(db, R"SQL(
+        SELECT a.id, a.name, (SELECT COUNT(*) FROM books b WHERE b.author_id=a.id)
+          FROM authors a WHERE a.name=?;
+    )SQL", nothrow);
+    if (!stmt.ok()) return dbError(db, stmt.rc);
+    stmt.bind(normalizeAuthor(name));
+    int rc = stmt.step();
+    if (rc == SQLITE_DONE) return ErrorCode::NotFound;
+    if (rc != SQLITE_ROW)  return dbError(db, rc);
+    Author a;
+    stmt.into(a.id, a.name, a.titles);
+    return a;
+}
+
+Result<vector<Author>> searchAuthors(const string& keyword) {
+    Stmt stmt(db, R"SQL(
+        SELECT a.id, a.name, COUNT(b.id) FROM authors a
+          LEFT JOIN books b ON b.author_id=a.id
+         WHERE a.name LIKE ?
+         GROUP BY a.id ORDER BY a.name;
+    )SQL", nothrow);
+    if (!stmt.ok()) return dbError(db, stmt.rc);
+    stmt.bind("%" + keyword + "%");
+    vector<Author> out;
+    int rc;
+    while ((rc = stmt.step()) == SQLITE_ROW) {
+        Author a;
+        stmt.into(a.id, a.name, a.titles);
+        out.push_back(move(a));
+    }
+    if (rc != SQLITE_DONE) return dbError(db, rc);
+    return out;
+}
+
+Result<vector<Book>> fetchBooksByAuthor(int authorID) {
+    Stmt stmt(db, R"SQL(
+        SELECT b.id, b.title, a.name, b.isbn, b.year, b.quantity
+          FROM books b JOIN authors a ON a.id=b.author_id
+         WHERE b.author_id=? ORDER BY b.title;
+    )SQL", nothrow);
+    if (!stmt.ok()) return dbError(db, stmt.rc);
+    stmt.bind(authorID);
+    vector<Book> out;
+    int rc;
+    while ((rc = stmt.step()) == SQLITE_ROW) {
+        Book b;
+        stmt.into(b.id, b.title, b.author, b.isbn, b.year, b.quantity);
+        out.push_back(move(b));
+    }
+    if (rc != SQLITE_DONE) return dbError(db, rc);
+    return out;
+}
+
+// ----------------------------------------------------------------
+// Borrow a book within a transaction: lend an available copy
+// ----------------------------------------------------------------
+Status tryBorrowBook(int bookID) {
+    if (!isUserLoggedIn()) return ErrorCode::NotLoggedIn;
+    if (!circ) return ErrorCode::Database;
+
+    return retryOnBusy(OpClass::Interactive, [bookID]() -> Status {
+        Transaction txn;
+        Status st = txn.begin();
+        if (!st) return st;
+
+        // Compare-and-take on items.status; zero rows changed is NoCopies
+        ErrorCode code = circ->checkout(currentUserID, bookID);
+        if (code != ErrorCode::Ok) return Error(code, sqlite3_errmsg(db));
+
+        return txn.commit();
+    });
+}
+
 bool borrowBook(int bookID) {
-    if (!isUserLoggedIn()) {
+    Status st = tryBorrowBook(bookID);
+    if (st.code() == ErrorCode::NotLoggedIn) {
         showErrorMessage("You must be logged in to borrow.");
-        return false;
+    } else if (!st) {
+        showErrorMessage("Borrow failed: " + st.error().message());
+    }
+    return st.ok();
+}
+
+// ----------------------------------------------------------------
+// Return a book within a transaction: close loan + shelve the copy
+// ----------------------------------------------------------------
+Status tryReturnBook(int bookID) {
+    if (!isUserLoggedIn()) return ErrorCode::NotLoggedIn;
+    if (!circ) return ErrorCode::Database;
+
+    return retryOnBusy(OpClass::Interactive, [bookID]() -> Status {
+        Transaction txn;
+        Status st = txn.begin();
+        if (!st) return st;
+
+        ErrorCode code = circ->checkin(bookID, currentUserID);
+        if (code != ErrorCode::Ok) return Error(code, sqlite3_errmsg(db));
+
+        return txn.commit();
+    });
+}
+
+bool returnBook(int bookID) {
+    Status st = tryReturnBook(bookID);
+    if (st.code() == ErrorCode::NotLoggedIn) {
+        showErrorMessage("You must be logged in to return.");
+    } else if (!st) {
+        showErrorMessage("Return failed: " + st.error().message());
+    }
+    return st.ok();
+}
+
+// ----------------------------------------------------------------
+// Branch router: branch 1 goes to the functions above, the others
+// to their own file. Writes take that file's write lock only.
+// ----------------------------------------------------------------
+Result<Branch> tryAddBranch(const string& name, const string& path) {
+    if (!db) return Error(ErrorCode::Database, "database is not open");
+    if (name.empty() || sqlite3_stricmp(name.c_str(), "Main") == 0)
+        return Error(ErrorCode::Constraint, "invalid branch name '" + name + "'");
+
+    // Id and default path come from one statement, so two instances
+    // adding branches at once cannot pick the same file
+    Status st = retryOnBusy(OpClass::Interactive, [&]() -> Status {
+        return execWrite(R"SQL(
+            INSERT INTO branches(id,name,path)
+            SELECT COALESCE(MAX(id),1)+1, ?1,
+                   COALESCE(NULLIF(?2,''), 'library_' || (COALESCE(MAX(id),1)+1) || '.db')
+              FROM branches;
+        )SQL", name, path);
+    });
+    if (!st) return st.error();
+
+    Branch b;
+    Stmt stmt(db, "SELECT id,name,path FROM branches WHERE id=?;", nothrow);
+    if (!stmt.ok()) return dbError(db, stmt.rc);
+    stmt.bind(static_cast<int>(sqlite3_last_insert_rowid(db)));
+    if (stmt.step() != SQLITE_ROW) return dbError(db, stmt.rc);
+    stmt.into(b.id, b.name, b.path);
+
+    unique_ptr<BranchShard> shard = openBranch(b);
+    if (!shard) {
+        execWrite("DELETE FROM branches WHERE id=?;", b.id);
+        return Error(ErrorCode::Database, "cannot open " + b.path);
+    }
+    lock_guard<mutex> g(branchLock);
+    if (branchUpkeep) startBranchMaintenance(*shard);
+    branchShards.push_back(move(shard));
+    federation.reset();   // both rebuilt with the new shard on next use
+    stockIndex.reset();
+    return b;
+}
+
+vector<Branch> listBranches() {
+    vector<Branch> out;
+    if (!db) return out;
+    out.push_back(Branch{ 1, "Main", getDBPath() });
+    lock_guard<mutex> g(branchLock);
+    for (auto& s : branchShards) out.push_back(s->info);
+    return out;
+}
+
+StorageEngine* getBranchStorage(int branchID) {
+    if (branchID == 1) return storage.get();
+    BranchShard* shard = findBranch(branchID);
+    return shard ? shard->storage.get() : nullptr;
+}
+
+static Status noBranch(int branchID) {
+    return Error(ErrorCode::NotFound, "no branch " + to_string(branchID));
+}
+
+Status tryAddBookAt(int branchID, const string& title, const string& author,
+                    const string& isbn, int year, int quantity)
+{
+    if (branchID == 1) return tryAddBook(title, author, isbn, year, quantity);
+    BranchShard* shard = findBranch(branchID);
+    if (!shard) return noBranch(branchID);
+    return insertBook(shard->conn, title, author, isbn, year, quantity);
+}
+
+Status tryBorrowAt(int branchID, int bookID) {
+    if (branchID == 1) return tryBorrowBook(bookID);
+    if (!isUserLoggedIn()) return ErrorCode::NotLoggedIn;
+    BranchShard* shard = findBranch(branchID);
+    if (!shard) return noBranch(branchID);
+
+    return retryOnBusy(OpClass::Interactive, [shard, bookID]() -> Status {
+        Transaction txn(shard->conn);
+        Status st = txn.begin();
+        if (!st) return st;
+
+        ErrorCode code = shard->circ->checkout(currentUserID, bookID);
+        if (code != ErrorCode::Ok) return Error(code, sqlite3_errmsg(shard->conn));
+
+        return txn.commit();
+    });
+}
+
+Status tryReturnAt(int branchID, int bookID) {
+    if (branchID == 1) return tryReturnBook(bookID);
+    if (!isUserLoggedIn()) return ErrorCode::NotLoggedIn;
+    BranchShard* shard = findBranch(branchID);
+    if (!shard) return noBranch(branchID);
+
+    return retryOnBusy(OpClass::Interactive, [shard, bookID]() -> Status {
+        Transaction txn(shard->conn);
+        Status st = txn.begin();
+        if (!st) return st;
+
+        ErrorCode code = shard->circ->checkin(bookID, currentUserID);
+        if (code != ErrorCode::Ok) return Error(code, sqlite3_errmsg(shard->conn));
+
+        return txn.commit();
+    });
+}
+
+Result<vector<ShardHit>> searchAllBranches(const string& keyword, size_t limit) {
+    if (!db) return Error(ErrorCode::Database, "database is not open");
+    shared_ptr<FederatedSearch> search;
+    {
+        lock_guard<mutex> g(branchLock);
+        if (!federation) {
+            vector<Shard> shards{ Shard{ 1, getDBPath() } };
+            for (auto& s : branchShards) shards.push_back(Shard{ s->info.id, s->info.path });
+            federation = make_shared<FederatedSearch>(shards);
+        }
+        search = federation;
+    }
+    if (!search->ok()) return Error(ErrorCode::Database, "cannot open every branch for searching");
+    return search->search(searchKey(keyword), limit);
+}
+
+// ----------------------------------------------------------------
+// Stock across branches
+// ----------------------------------------------------------------
+static shared_ptr<AvailabilityIndex> availabilityIndex() {
+    shared_ptr<AvailabilityIndex> index;
+    {
+        lock_guard<mutex> g(branchLock);
+        if (!stockIndex) {
+            vector<Shard> shards{ Shard{ 1, getDBPath() } };
+            for (auto& s : branchShards) shards.push_back(Shard{ s->info.id, s->info.path });
+            vector<BranchSite> sites;
+            Stmt stmt(db, "SELECT branch_id, lat, lon FROM branch_locations;", nothrow);
+            if (stmt.ok()) {
+                while (stmt.step() == SQLITE_ROW) {
+                    BranchSite site;
+                    stmt.into(site.branchID, site.lat, site.lon);
+                    sites.push_back(site);
+                }
+            }
+            stockIndex = make_shared<AvailabilityIndex>(shards, sites);
+        }
+        index = stockIndex;
+    }
+    index->refresh(stockTtlMs);
+    return index;
+}
+
+Result<vector<BranchStock>> fetchBranchAvailability(const string& isbn) {
+    if (!db) return Error(ErrorCode::Database, "database is not open");
+    long long key = normalizeIsbn(isbn);
+    if (!key) return Error(ErrorCode::Constraint, "invalid ISBN " + isbn);
+    shared_ptr<AvailabilityIndex> index = availabilityIndex();
+    if (!index->ok()) return Error(ErrorCode::Database, "cannot open every branch for availability");
+    return index->stock(key);
+}
+
+Result<NearestCopy> findNearestCopy(const string& isbn, int fromBranch) {
+    if (!db) return Error(ErrorCode::Database, "database is not open");
+    long long key = normalizeIsbn(isbn);
+    if (!key) return Error(ErrorCode::Constraint, "invalid ISBN " + isbn);
+    if (!branchConnection(fromBranch)) return noBranch(fromBranch).error();
+    shared_ptr<AvailabilityIndex> index = availabilityIndex();
+    if (!index->ok()) return Error(ErrorCode::Database, "cannot open every branch for availability");
+    NearestCopy near = index->nearest(key, fromBranch);
+    if (!near.branchID) return Error(ErrorCode::NoCopies, "no branch has a copy of " + isbn);
+    return near;
+}
+
+Status setBranchLocation(int branchID, double lat, double lon) {
+    if (!db) return Error(ErrorCode::Database, "database is not open");
+    if (!branchConnection(branchID)) return noBranch(branchID);
+    if (lat < -90 || lat > 90 || lon < -180 || lon > 180)
+        return Error(ErrorCode::Constraint, "location out of range");
+    Status st = retryOnBusy(OpClass::Interactive, [&]() -> Status {
+        return execWrite("INSERT OR REPLACE INTO branch_locations(branch_id,lat,lon) VALUES(?,?,?);",
+                         branchID, lat, lon);
+    });
+    if (!st) return st;
+    lock_guard<mutex> g(branchLock);
+    stockIndex.reset();   // distances are worked out when it is built
+    return st;
+}
+
+void setAvailabilityTtl(int millis) {
+    stockTtlMs = millis < 0 ? 0 : millis;
+}
+
+// ----------------------------------------------------------------
+// Transfers. The sending file withdraws the copies and records one
+// transfers row per copy in one transaction; the receiving file then
+// shelves them, noting each in arrivals so a repeat changes nothing;
+// last the sender marks its rows received. A crash between the steps
+// leaves rows that completeTransfers delivers again.
+// ----------------------------------------------------------------
+
+// addCopies barcodes are only unique within a file, so a copy away
+// from home carries its home branch ("2:15-1") until it gets back
+static string travelBarcode(const string& code, int fromBranch, int toBranch) {
+    size_t colon = code.find(':');
+    if (colon == string::npos) return to_string(fromBranch) + ':' + code;
+    if (code.compare(0, colon, to_string(toBranch)) == 0) return code.substr(colon + 1);
+    return code;
+}
+
+namespace {
+struct InTransit {
+    long long id;
+    string    barcode;
+    string    title;
+    string    author;
+    string    isbn;
+    int       year;
+    long long isbn13;
+};
+}
+
+// Shelve at to every copy from has in transit there
+static Result<int> deliverTransfers(int fromBranch, sqlite3* from, int toBranch, sqlite3* to) {
+    vector<InTransit> moving;
+    {
+        Stmt stmt(from, R"SQL(
+            SELECT t.id, t.barcode, b.title, a.name, b.isbn, b.year, t.isbn13
+              FROM transfers t
+              JOIN books b ON b.isbn13=t.isbn13
+              JOIN authors a ON a.id=b.author_id
+             WHERE t.to_branch=? AND t.received IS NULL ORDER BY t.id;
+        )SQL", nothrow);
+        if (!stmt.ok()) return dbError(from, stmt.rc);
+        stmt.bind(toBranch);
+        int rc;
+        while ((rc = stmt.step()) == SQLITE_ROW) {
+            InTransit t;
+            stmt.into(t.id, t.barcode, t.title, t.author, t.isbn, t.year, t.isbn13);
+            moving.push_back(move(t));
+        }
+        if (rc != SQLITE_DONE) return dbError(from, rc);
+    }
+    if (moving.empty()) return 0;
+
+    Result<int> shelved = retryOnBusy(OpClass::Interactive, [&]() -> Result<int> {
+        Transaction txn(to);
+        Status st = txn.begin();
+        if (!st) return st.error();
+        Stmt arrive(to, "INSERT INTO arrivals(from_branch,transfer_id) VALUES(?,?) ON CONFLICT DO NOTHING;", nothrow);
+        Stmt title(to, "SELECT id FROM books WHERE isbn13=?;", nothrow);
+        Stmt shelve(to, R"SQL(
+            INSERT INTO items(book_id, barcode) VALUES(?1, ?2)
+            ON CONFLICT(barcode) DO UPDATE SET book_id=?1, status='available'
+             WHERE status='withdrawn';
+        )SQL", nothrow);
+        if (!arrive.ok() || !title.ok() || !shelve.ok()) return dbError(to, sqlite3_errcode(to));
+        int count = 0;
+        for (const InTransit& t : moving) {
+            arrive.reset();
+            arrive.bind(fromBranch, t.id);
+            if (!arrive.done()) return dbError(to, arrive.rc);
+            if (!sqlite3_changes(to)) continue;   // delivered before
+
+            title.reset();
+            title.bind(t.isbn13);
+            int bookID = 0;
+            if (title.step() == SQLITE_ROW) {
+                bookID = get<0>(title.row<int>());
+            } else {
+                int authorID = internAuthor(to, t.author);
+                if (!authorID) return dbError(to, sqlite3_errcode(to));
+                st = execWriteOn(to, "INSERT INTO books(title,author_id,isbn,isbn13,year,quantity)"
+                                     " VALUES(?,?,?,?,?,0);",
+                                 t.title, authorID, t.isbn, t.isbn13, t.year);
+                if (!st) return st.error();
+                bookID = static_cast<int>(sqlite3_last_insert_rowid(to));
+            }
+            shelve.reset();
+            shelve.bind(bookID, travelBarcode(t.barcode, fromBranch, toBranch));
+            if (!shelve.done()) return dbError(to, shelve.rc);
+            if (!sqlite3_changes(to))
+                return Error(ErrorCode::Constraint, "barcode " + t.barcode + " is already on the shelf");
+            ++count;
+        }
+        st = txn.commit();
+        if (!st) return st.error();
+        return count;
+    });
+    if (!shelved) return shelved;
+
+    Status st = retryOnBusy(OpClass::Interactive, [&]() -> Status {
+        return execWriteOn(from, "UPDATE transfers SET received=? WHERE to_branch=? AND received IS NULL AND id<=?;",
+                           todayDay(), toBranch, moving.back().id);
+    });
+    if (!st) return st.error();
+    if (toBranch == 1) invalidateSearches();
+    return shelved;
+}
+
+Result<int> tryTransferCopies(const string& isbn, int fromBranch, int toBranch, int copies) {
+    long long key = normalizeIsbn(isbn);
+    if (!key) return Error(ErrorCode::Constraint, "invalid ISBN " + isbn);
+    if (copies <= 0 || fromBranch == toBranch)
+        return Error(ErrorCode::Constraint, "nothing to transfer");
+    sqlite3* from = branchConnection(fromBranch);
+    sqlite3* to   = branchConnection(toBranch);
+    if (!from) return noBranch(fromBranch).error();
+    if (!to)   return noBranch(toBranch).error();
+
+    Result<int> sent = retryOnBusy(OpClass::Interactive, [&]() -> Result<int> {
+        Transaction txn(from);
+        Status st = txn.begin();
+        if (!st) return st.error();
+        long long last = 0;
+        {
+            Stmt stmt(from, "SELECT COALESCE(MAX(id),0) FROM transfers;", nothrow);
+            if (!stmt.ok() || stmt.step() != SQLITE_ROW) return dbError(from, stmt.rc);
+            last = get<0>(stmt.row<long long>());
+        }
+        st = execWriteOn(from, R"SQL(
+            INSERT INTO transfers(to_branch, isbn13, barcode, sent)
+            SELECT ?1, ?2, i.barcode, ?3 FROM items i JOIN books b ON b.id=i.book_id
+             WHERE b.isbn13=?2 AND i.status='available' ORDER BY i.id LIMIT ?4;
+        )SQL", toBranch, key, todayDay(), copies);
+        if (!st) return st.error();
+        int n = sqlite3_changes(from);
+        if (!n) return Error(ErrorCode::NoCopies, "no copies of " + isbn + " on the shelf");
+        // Withdrawn, not deleted: loans keep their item, and the
+        // barcode is not handed out again by addCopies
+        st = execWriteOn(from, "UPDATE items SET status='withdrawn'"
+                               " WHERE barcode IN (SELECT barcode FROM transfers WHERE id>?);", last);
+        if (!st) return st.error();
+        st = txn.commit();
+        if (!st) return st.error();
+        return n;
+    });
+    if (!sent) return sent;
+    if (fromBranch == 1) invalidateSearches();
+
+    // The copies have left; if shelving them fails they stay in transit
+    Result<int> shelved = deliverTransfers(fromBranch, from, toBranch, to);
+    if (!shelved)
+        return Error(shelved.code(), to_string(sent.value()) + " copies in transit: " + shelved.error().message());
+    return sent;
+}
+
+int completeTransfers() {
+    vector<Branch> branches = listBranches();
+    int delivered = 0;
+    for (const Branch& from : branches) {
+        sqlite3* conn = branchConnection(from.id);
+        vector<int> targets;
+        {
+            Stmt stmt(conn, "SELECT DISTINCT to_branch FROM transfers WHERE received IS NULL;", nothrow);
+            if (stmt.ok())
+                while (stmt.step() == SQLITE_ROW) targets.push_back(get<0>(stmt.row<int>()));
+        }
+        for (int toBranch : targets) {
+            sqlite3* to = branchConnection(toBranch);
+            if (!to) continue;   // that branch is not open
+            Result<int> r = deliverTransfers(from.id, conn, toBranch, to);
+            if (r) delivered += r.value();
+        }
+    }
+    return delivered;
+}
+
+// ----------------------------------------------------------------
+// Copy-level helpers
+// ----------------------------------------------------------------
+Result<int> findAvailableCopy(int bookID) {
+    if (!circ) return ErrorCode::Database;
+    int itemID = 0;
+    ErrorCode code = circ->findAvailable(bookID, itemID);
+    if (code != ErrorCode::Ok) return code;
+    return itemID;
+}
+
+Result<Availability> fetchAvailability(int bookID) {
+    Stmt stmt(db, R"SQL(
+        SELECT quantity,
+               (SELECT COUNT(*) FROM items WHERE book_id=?1 AND status IN ('available','on_loan')),
+               (SELECT COUNT(*) FROM holds WHERE book_id=?1 AND status='waiting')
+          FROM books WHERE id=?1;
+    )SQL", nothrow);
+    if (!stmt.ok()) return dbError(db, stmt.rc);
+    stmt.bind(bookID);
+    int rc = stmt.step();
+    if (rc == SQLITE_DONE) return ErrorCode::NotFound;
+    if (rc != SQLITE_ROW)  return dbError(db, rc);
+    Availability a;
+    stmt.into(a.available, a.copies, a.holds);
+    return a;
+}
+
+Status tryAddCopy(int bookID, const string& barcode) {
+    Status st = execWrite("INSERT INTO items(book_id,barcode) "
+                          "SELECT id, ? FROM books WHERE id=?;", barcode, bookID);
+    if (st && sqlite3_changes(db) == 0) return Error(ErrorCode::NotFound, "no book with that ID");
+    return st;
+}
+
+// ----------------------------------------------------------------
+// Also borrowed: built offline, served from memory
+// ----------------------------------------------------------------
+static long long latestBuild() {
+    Stmt stmt(db, "SELECT COALESCE(MAX(id),0) FROM recommendation_builds;", nothrow);
+    if (!stmt.ok() || stmt.step() != SQLITE_ROW) return -1;
+    return get<0>(stmt.row<long long>());
+}
+
+static shared_ptr<const CoBorrowIndex> recommendations() {
+    {
+        lock_guard<mutex> g(recommendLock);
+        auto now = chrono::steady_clock::now();
+        if (coBorrow && now - coBorrowChecked < chrono::minutes(1)) return coBorrow;
+        coBorrowChecked = now;
+    }
+    lock_guard<mutex> l(recommendLoad);
+    long long build = latestBuild();
+    {
+        lock_guard<mutex> g(recommendLock);
+        if (coBorrow && build == coBorrowBuild) return coBorrow;
+    }
+    vector<pair<int, AlsoBorrowed>> rows;
+    Stmt stmt(db, "SELECT book_id, other_id, patrons FROM also_borrowed ORDER BY book_id, rank;", nothrow);
+    if (stmt.ok()) {
+        while (stmt.step() == SQLITE_ROW) {
+            pair<int, AlsoBorrowed> r;
+            stmt.into(r.first, r.second.bookID, r.second.patrons);
+            rows.push_back(r);
+        }
+    }
+    auto index = make_shared<const CoBorrowIndex>(CoBorrowIndex::fromRows(rows));
+    lock_guard<mutex> g(recommendLock);
+    coBorrow      = index;
+    coBorrowBuild = build;
+    return coBorrow;
+}
+
+RecommendStats buildRecommendations(const RecommendConfig& config) {
+    RecommendStats out;
+    shared_ptr<sqlite3> conn = reportConnection();
+    if (!conn) {
+        out.status = Error(ErrorCode::Database, "database is not open");
+        return out;
     }
-    char* err = nullptr;
-    if (sqlite3_exec(db,"BEGIN;",nullptr,nullptr,&err)!=SQLITE_OK) {
-        showErrorMessage(string("Begin failed: ")+err);
-        sqlite3_free(err);
+    auto seconds = [](chrono::steady_clock::time_point since) {
+        return chrono::duration<double>(chrono::steady_clock::now() - since).count();
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<pair<int, int>> pairs;
+    {
+        Stmt stmt(conn.get(), "SELECT DISTINCT user_id, book_id FROM loans ORDER BY user_id, book_id;", nothrow);
+        if (!stmt.ok()) {
+            out.status = dbError(conn.get(), stmt.rc);
+            return out;
+        }
+        int rc;
+        while ((rc = stmt.step()) == SQLITE_ROW) {
+            auto r = stmt.row<int, int>();
+            pairs.emplace_back(get<0>(r), get<1>(r));
+        }
+        if (rc != SQLITE_DONE) {
+            out.status = dbError(conn.get(), rc);
+            return out;
+        }
+    }
+    conn.reset();
+    out.loadSeconds = seconds(start);
+
+    start = chrono::steady_clock::now();
+    out.threads = config.threads > 0 ? config.threads : static_cast<int>(thread::hardware_concurrency());
+    auto index = make_shared<const CoBorrowIndex>(CoBorrowIndex::build(pairs, config));
+    out.buildSeconds = seconds(start);
+    out.patrons = index->patrons();
+    out.books   = index->books();
+    out.pairs   = index->pairs();
+
+    // A batch of books per transaction keeps desks from waiting on the
+    // whole store; a lookup meanwhile sees old and new lists, both valid.
+    // Each batch replaces every book id from the end of the previous one
+    // up to its own last book, so lists of books that lost theirs go too.
+    // The store writes through a connection of its own, as builds run on
+    // a thread beside the desks and db has one transaction at a time.
+    start = chrono::steady_clock::now();
+    sqlite3* writer = nullptr;
+    if (sqlite3_open(getDBPath().c_str(), &writer) != SQLITE_OK) {
+        out.status = dbError(writer, sqlite3_errcode(writer));
+        sqlite3_close(writer);
+        return out;
+    }
+    enableBusyHandling(writer);
+    addWriterConnection(writer);
+    vector<pair<int, AlsoBorrowed>> rows;
+    index->forEach([&rows](int bookID, const AlsoBorrowed* n, size_t count) {
+        for (size_t k = 0; k < count; ++k) rows.emplace_back(bookID, n[k]);
+    });
+    const size_t batchRows = 5000;
+    long long from = INT64_MIN;
+    for (size_t at = 0; at < rows.size() || from != INT64_MAX; ) {
+        size_t end = min(at + batchRows, rows.size());
+        while (end < rows.size() && rows[end].first == rows[end - 1].first) ++end;
+        long long to = end < rows.size() ? rows[end - 1].first : INT64_MAX;
+        Status st = retryOnBusy(OpClass::Batch, [&]() -> Status {
+            Transaction txn(writer);
+            Status s = txn.begin();
+            if (!s) return s;
+            s = execWriteOn(writer, "DELETE FROM also_borrowed WHERE book_id BETWEEN ? AND ?;", from, to);
+            if (!s) return s;
+            Stmt ins(writer, "INSERT INTO also_borrowed(book_id,rank,other_id,patrons) VALUES(?,?,?,?);", nothrow);
+            if (!ins.ok()) return dbError(writer, ins.rc);
+            for (size_t k = at, rank = 0; k < end; ++k) {
+                rank = k > at && rows[k].first == rows[k - 1].first ? rank + 1 : 0;
+                ins.reset();
+                ins.bind(rows[k].first, static_cast<int>(rank), rows[k].second.bookID, rows[k].second.patrons);
+                if (!ins.done()) return dbError(writer, ins.rc);
+            }
+            return txn.commit();
+        });
+        if (!st) {
+            out.status = st;
+            removeWriterConnection(writer);
+            sqlite3_close(writer);
+            return out;
+        }
+        at   = end;
+        from = to == INT64_MAX ? to : to + 1;
+    }
+    Status st = execWriteOn(writer, "INSERT INTO recommendation_builds(built,patrons,books,pairs) VALUES(?,?,?,?);",
+                            todayDay(), out.patrons, static_cast<long long>(out.books),
+                            static_cast<long long>(out.pairs));
+    long long build = static_cast<long long>(sqlite3_last_insert_rowid(writer));
+    removeWriterConnection(writer);
+    sqlite3_close(writer);
+    out.storeSeconds = seconds(start);
+    if (!st) {
+        out.status = st;
+        return out;
+    }
+
+    lock_guard<mutex> g(recommendLock);
+    coBorrow        = index;
+    coBorrowBuild   = build;
+    coBorrowChecked = chrono::steady_clock::now();
+    return out;
+}
+
+Result<vector<AlsoBorrowed>> fetchAlsoBorrowed(int bookID, size_t limit) {
+    if (!db) return Error(ErrorCode::Database, "database is not open");
+    shared_ptr<const CoBorrowIndex> index = recommendations();
+    auto n = index->neighbours(bookID);
+    return vector<AlsoBorrowed>(n.first, n.first + min(n.second, limit));
+}
+
+Result<BookDetails> fetchBookDetails(int bookID, size_t alsoBorrowed) {
+    if (!storage) return Error(ErrorCode::Database, "database is not open");
+    BookDetails d;
+    if (!storage->books().findByID(bookID, d.book)) return Error(ErrorCode::NotFound, "no book with that ID");
+    Result<Availability> a = fetchAvailability(bookID);
+    if (!a) return a.error();
+    d.availability = a.value();
+    Result<vector<AlsoBorrowed>> also = fetchAlsoBorrowed(bookID, alsoBorrowed);
+    if (!also) return also.error();
+    for (const AlsoBorrowed& n : also.value()) {
+        Book b;
+        if (storage->books().findByID(n.bookID, b)) d.alsoBorrowed.push_back(move(b));   // deleted since the build
+    }
+    return d;
+}
+
+// ----------------------------------------------------------------
+// Holds: queue the current user for a title with no copy on the
+// shelf. Returns hand the copy to the head of the queue (see
+// Circulation::close), so waiting patrons never need to poll.
+// ----------------------------------------------------------------
+Result<int> tryPlaceHold(int bookID, int priority) {
+    if (!isUserLoggedIn()) return ErrorCode::NotLoggedIn;
+
+    return retryOnBusy(OpClass::Interactive, [bookID, priority]() -> Result<int> {
+        Transaction txn;
+        Status st = txn.begin();
+        if (!st) return st.error();
+
+        Stmt qty(db, "SELECT quantity FROM books WHERE id=?;", nothrow);
+        if (!qty.ok()) return dbError(db, qty.rc);
+        qty.bind(bookID);
+        int rc = qty.step();
+        if (rc == SQLITE_DONE) return ErrorCode::NotFound;
+        if (rc != SQLITE_ROW)  return dbError(db, rc);
+        if (get<0>(qty.row<int>()) > 0)
+            return Error(ErrorCode::Constraint, "a copy is available; borrow it instead");
+
+        st = execWrite("INSERT INTO holds(user_id,book_id,priority,placed_at) VALUES(?,?,?,?);",
+                       currentUserID, bookID, priority, todayDay());
+        if (!st) return st.error();
+
+        // 1-based place in the queue: higher priority first, then FIFO
+        Stmt pos(db, R"SQL(
+            SELECT COUNT(*) FROM holds
+             WHERE book_id=?1 AND status='waiting'
+               AND (priority > ?2 OR (priority = ?2 AND id <= ?3));
+        )SQL", nothrow);
+        if (!pos.ok()) return dbError(db, pos.rc);
+        pos.bind(bookID, priority, static_cast<long long>(sqlite3_last_insert_rowid(db)));
+        if (pos.step() != SQLITE_ROW) return dbError(db, pos.rc);
+        int position = get<0>(pos.row<int>());
+
+        st = txn.commit();
+        if (!st) return st.error();
+        return position;
+    });
+}
+
+Status tryCancelHold(int bookID) {
+    if (!isUserLoggedIn()) return ErrorCode::NotLoggedIn;
+    Status st = execWrite("UPDATE holds SET status='cancelled' "
+                          "WHERE user_id=? AND book_id=? AND status='waiting';",
+                          currentUserID, bookID);
+    if (st && sqlite3_changes(db) == 0) return Error(ErrorCode::NotFound, "no waiting hold");
+    return st;
+}
+
+bool placeHold(int bookID) {
+    Result<int> r = tryPlaceHold(bookID);
+    if (!r) {
+        showErrorMessage("Hold failed: " + r.error().message());
         return false;
     }
+    cout << "Hold placed on book " << bookID << ", position " << r.value() << endl;
+    return true;
+}
+
+bool cancelHold(int bookID) {
+    Status st = tryCancelHold(bookID);
+    if (!st) showErrorMessage("Cancel hold failed: " + st.error().message());
+    return st.ok();
+}
+
+void fetchHolds(int userID) {
+    const char* sql = R"SQL(
+        SELECT b.title, h.placed_at, h.status FROM holds h
+          JOIN books b ON h.book_id=b.id
+         WHERE h.user_id=? AND h.status IN ('waiting','fulfilled')
+         ORDER BY h.id DESC;
+    )SQL";
     try {
-        // Decrement quantity
-        Stmt s1(db,"UPDATE books SET quantity=quantity-1 WHERE id=? AND quantity>0;");
-        sqlite3_bind_int(s1.stmt,1,bookID);
-        if (sqlite3_step(s1.stmt)!=SQLITE_DONE)
-            throw runtime_error("No copies available.");
-
-        // Insert loan record
-        Stmt s2(db,"INSERT INTO loans(user_id,book_id,borrow_date) VALUES(?,?,DATE('now'));");
-        sqlite3_bind_int(s2.stmt,1,currentUserID);
-        sqlite3_bind_int(s2.stmt,2,bookID);
-        if (sqlite3_step(s2.stmt)!=SQLITE_DONE)
-            throw runtime_error(sqlite3_errmsg(db));
-
-        // Commit
-        if (sqlite3_exec(db,"COMMIT;",nullptr,nullptr,&err)!=SQLITE_OK)
-            throw runtime_error(err);
-
-        return true;
-    }
-    catch (const exception& ex) {
-        sqlite3_exec(db,"ROLLBACK;",nullptr,nullptr,nullptr);
-        showErrorMessage(string("Borrow failed: ") + ex.what());
-        return false;
+        Stmt stmt(db, sql);
+        stmt.bind(userID);
+        stmt.forEach<string_view, int, string_view>(
+            [](string_view title, int placed, string_view status) {
+                cout<<"Title: "<<title
+                    <<", Placed: "<<dayToDate(placed)
+                    <<", Status: "<<status
+                    <<endl;
+            });
+    } catch (...) {
+        showErrorMessage("Failed to fetch holds.");
     }
 }
 
 // ----------------------------------------------------------------
-// Return a book within a transaction: increment qty + update loan
+// Batch checkout: one transaction, statements prepared once
 // ----------------------------------------------------------------
-bool returnBook(int bookID) {
+// SAVEPOINT/RELEASE/ROLLBACK TO inside the batch; a failure here would
+// leave a half-applied item in the transaction, so the batch stops
+static Status execSavepoint(const char* sql) {
+    if (sqlite3_exec(db, sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+        return Error(ErrorCode::Database, string(sql) + " " + sqlite3_errmsg(db));
+    return Status();
+}
+
+BatchResult borrowBooks(const vector<int>& bookIDs, BatchMode mode) {
+    BatchResult res;
     if (!isUserLoggedIn()) {
-        showErrorMessage("You must be logged in to return.");
-        return false;
+        res.status = ErrorCode::NotLoggedIn;
+        return res;
     }
-    char* err = nullptr;
-    if (sqlite3_exec(db,"BEGIN;",nullptr,nullptr,&err)!=SQLITE_OK) {
-        showErrorMessage(string("Begin failed: ")+err);
-        sqlite3_free(err);
-        return false;
+    if (!circ) {
+        res.status = ErrorCode::Database;
+        return res;
     }
-    try {
-        // Increment quantity
-        Stmt s1(db,"UPDATE books SET quantity=quantity+1 WHERE id=?;");
-        sqlite3_bind_int(s1.stmt,1,bookID);
-        if (sqlite3_step(s1.stmt)!=SQLITE_DONE)
-            throw runtime_error(sqlite3_errmsg(db));
-
-        // Update return_date in latest loan
-        const char* upSQL = R"SQL(
-            UPDATE loans SET return_date=DATE('now')
-             WHERE user_id=? AND book_id=? AND return_date IS NULL
-             ORDER BY borrow_date DESC LIMIT 1;
-        )SQL";
-        Stmt s2(db,upSQL);
-        sqlite3_bind_int(s2.stmt,1,currentUserID);
-        sqlite3_bind_int(s2.stmt,2,bookID);
-        sqlite3_step(s2.stmt);
-
-        // Commit
-        if (sqlite3_exec(db,"COMMIT;",nullptr,nullptr,&err)!=SQLITE_OK)
-            throw runtime_error(err);
-
-        return true;
-    }
-    catch (const exception& ex) {
-        sqlite3_exec(db,"ROLLBACK;",nullptr,nullptr,nullptr);
-        showErrorMessage(string("Return failed: ") + ex.what());
-        return false;
+    res.status = retryOnBusy(OpClass::Interactive, [&]() -> Status {
+        res.items.clear();
+        res.succeeded = 0;
+        Transaction txn;
+        Status st = txn.begin();
+        if (!st) return st;
+
+        res.items.reserve(bookIDs.size());
+        for (int bookID : bookIDs) {
+            // A savepoint per item lets Partial mode undo a half-applied item
+            if (mode == BatchMode::Partial) {
+                st = execSavepoint("SAVEPOINT item;");
+                if (!st) return st;
+            }
+            ErrorCode code = circ->checkout(currentUserID, bookID);
+            if (code == ErrorCode::Busy) return code;   // the whole batch again
+            res.items.push_back({bookID, code});
+            if (code == ErrorCode::Ok) {
+                ++res.succeeded;
+                if (mode == BatchMode::Partial) {
+                    st = execSavepoint("RELEASE item;");
+                    if (!st) return st;
+                }
+                continue;
+            }
+            if (mode == BatchMode::AllOrNothing)
+                return Error(code, "book " + to_string(bookID));   // Transaction destructor rolls back
+            st = execSavepoint("ROLLBACK TO item; RELEASE item;");
+            if (!st) return st;
+        }
+        return txn.commit();
+    });
+    if (!res.status) res.succeeded = 0;
+    return res;
+}
+
+// ----------------------------------------------------------------
+// Bulk return: resolve each open loan through the open-loan indexes
+// and commit in short batches so checkouts are not locked out for long
+// ----------------------------------------------------------------
+template <typename Key, typename CheckIn>
+static BulkReturnResult bulkReturn(const vector<Key>& keys, size_t batchSize, CheckIn checkIn) {
+    BusyScope scope(OpClass::Batch);
+    BulkReturnResult res;
+    if (!isUserLoggedIn()) {
+        res.status = ErrorCode::NotLoggedIn;
+        return res;
     }
+    if (!circ) {
+        res.status = ErrorCode::Database;
+        return res;
+    }
+    if (batchSize == 0) batchSize = 1;
+    auto start = chrono::steady_clock::now();
+
+    for (size_t pos = 0; pos < keys.size(); ) {
+        size_t end = min(keys.size(), pos + batchSize);
+        Transaction txn;
+        res.status = txn.begin();
+        if (!res.status) break;
+
+        int            returned = 0;
+        vector<string> unmatched;
+        for (; pos < end; ++pos) {
+            ErrorCode code = checkIn(keys[pos]);
+            if (code == ErrorCode::NotFound) {
+                unmatched.push_back(keyText(keys[pos]));
+            } else if (code != ErrorCode::Ok) {
+                res.status = Error(code, sqlite3_errmsg(db));
+                break;
+            } else {
+                ++returned;
+            }
+        }
+        if (res.status) res.status = txn.commit();
+        if (!res.status) break;   // this batch rolled back; earlier ones stand
+
+        res.returned += returned;
+        res.unmatched.insert(res.unmatched.end(), unmatched.begin(), unmatched.end());
+    }
+    res.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return res;
+}
+
+BulkReturnResult returnBooksBulk(const vector<int>& bookIDs, size_t batchSize) {
+    return bulkReturn(bookIDs, batchSize, [](int bookID) {
+        return circ->checkin(bookID);
+    });
+}
+
+BulkReturnResult returnItemsBulk(const vector<string>& codes, size_t batchSize) {
+    return bulkReturn(codes, batchSize, [](const string& code) {
+        Circulation::Target t;
+        ErrorCode rc = circ->resolve(code, t);
+        if (rc != ErrorCode::Ok) return rc;
+        return t.itemID ? circ->checkinItem(t.itemID) : circ->checkin(t.bookID);
+    });
 }
 
 // ----------------------------------------------------------------
-// Fetch borrow history for a user
+// Archival: move closed loans into archive.loans in short batches.
+// Each batch is its own IMMEDIATE transaction and the scan resumes
+// after the last id moved, so the write lock is only ever held for
+// one batch and the table is walked once overall.
+//
+// In WAL mode a transaction over two files commits each file on its
+// own, so a crash can leave a batch in both tables. Loan ids are
+// AUTOINCREMENT and closed loans never change, so a row already in
+// archive.loans is that same loan: the copy skips it and the delete
+// finishes the move. Until the next run such loans are listed twice
+// in the full history, and none is ever lost.
 // ----------------------------------------------------------------
-void fetchBorrowHistory(int userID) {
-    const char* sql = R"SQL(
-        SELECT b.title,l.borrow_date,l.return_date
+ArchiveResult archiveLoans(int olderThanDays, size_t batchSize) {
+    ArchiveResult res;
+    if (!archiveReady) {
+        res.status = Error(ErrorCode::Database, "archive database is not attached");
+        return res;
+    }
+    if (batchSize == 0) batchSize = 1;
+    auto start = chrono::steady_clock::now();
+    int cutoff = todayDay() - olderThanDays;
+    res.status = execWrite("CREATE TEMP TABLE IF NOT EXISTS archive_batch(id INTEGER PRIMARY KEY);");
+
+    long long lastID = 0;
+    for (int moved = 1; res.status && moved > 0; ) {
+        res.status = retryOnBusy(OpClass::Maintenance, [&]() -> Status {
+            Transaction txn;
+            Status st = txn.begin();
+            if (!st) return st;
+            st = execWrite("DELETE FROM temp.archive_batch;");
+            if (!st) return st;
+            st = execWrite(R"SQL(
+                INSERT INTO temp.archive_batch
+                    SELECT id FROM main.loans
+                     WHERE id > ? AND return_date IS NOT NULL AND return_date < ?
+                     ORDER BY id LIMIT ?;
+            )SQL", lastID, cutoff, static_cast<long long>(batchSize));
+            if (!st) return st;
+            moved = sqlite3_changes(db);
+            if (moved == 0) return txn.commit();
+
+            st = execWrite(R"SQL(
+                INSERT OR IGNORE INTO archive.loans(id,user_id,book_id,item_id,borrow_date,return_date)
+                    SELECT id,user_id,book_id,item_id,borrow_date,return_date
+                      FROM main.loans WHERE id IN temp.archive_batch;
+            )SQL");
+            if (!st) return st;
+            st = execWrite("DELETE FROM main.loans WHERE id IN temp.archive_batch;");
+            if (!st) return st;
+            return txn.commit();
+        });
+        if (res.status && moved > 0) {
+            Stmt last(db, "SELECT MAX(id) FROM temp.archive_batch;", nothrow);
+            if (last.ok() && last.step() == SQLITE_ROW) lastID = get<0>(last.row<long long>());
+            res.moved += moved;
+            ++res.batches;
+        }
+    }
+    res.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return res;
+}
+
+// ----------------------------------------------------------------
+// Online backup from a read-only connection of its own (see
+// copyDatabase). Written to path.tmp and renamed, so path is never
+// a partial copy.
+// ----------------------------------------------------------------
+static Status gzipFile(const string& from, const string& to) {
+    FILE* in = fopen(from.c_str(), "rb");
+    if (!in) return Error(ErrorCode::Database, "cannot read " + from);
+    gzFile out = gzopen(to.c_str(), "wb6");
+    if (!out) {
+        fclose(in);
+        return Error(ErrorCode::Database, "cannot write " + to);
+    }
+    vector<char> buf(1 << 16);
+    bool ok = true;
+    size_t n;
+    while (ok && (n = fread(buf.data(), 1, buf.size(), in)) > 0)
+        ok = gzwrite(out, buf.data(), static_cast<unsigned>(n)) == static_cast<int>(n);
+    ok = ok && !ferror(in);
+    fclose(in);
+    if (gzclose(out) != Z_OK) ok = false;
+    return ok ? Status() : Error(ErrorCode::Database, "cannot compress into " + to);
+}
+
+BackupResult backupDatabase(const string& path, const BackupOptions& options) {
+    BackupResult res;
+    string tmp = path + ".tmp";
+    string raw = options.compress ? path + ".raw" : tmp;   // uncompressed copy
+    auto fail = [&](Status st) {
+        std::remove(raw.c_str());
+        std::remove(tmp.c_str());
+        res.status = st;
+        return res;
+    };
+
+    std::remove(raw.c_str());
+    sqlite3* src = nullptr;
+    if (sqlite3_open_v2(getDBPath().c_str(), &src, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        sqlite3_close(src);
+        return fail(Error(ErrorCode::Database, "cannot open " + getDBPath()));
+    }
+    enableBusyHandling(src);
+    sqlite3* dest = nullptr;
+    if (sqlite3_open(raw.c_str(), &dest) != SQLITE_OK) {
+        sqlite3_close(dest);
+        sqlite3_close(src);
+        return fail(Error(ErrorCode::Database, "cannot create " + raw));
+    }
+    // The file is renamed into place only once complete
+    sqlite3_exec(dest, "PRAGMA journal_mode=OFF;", nullptr, nullptr, nullptr);
+
+    auto start = chrono::steady_clock::now();
+    int rc;
+    {
+        BusyScope scope(OpClass::Maintenance);
+        rc = copyDatabase(src, dest, options.pagesPerStep, options.pauseMs, &res.pages, &res.steps);
+    }
+    res.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (res.seconds > 0) res.pagesPerSecond = res.pages / res.seconds;
+    Status copied = rc == SQLITE_OK ? Status() : dbError(dest, rc);
+    sqlite3_close(dest);
+    sqlite3_close(src);
+    if (!copied) return fail(copied);
+
+    if (options.compress) {
+        auto zipStart = chrono::steady_clock::now();
+        Status st = gzipFile(raw, tmp);
+        std::remove(raw.c_str());
+        if (!st) return fail(st);
+        res.compressSeconds = chrono::duration<double>(chrono::steady_clock::now() - zipStart).count();
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        return fail(Error(ErrorCode::Database, "cannot rename " + tmp + " to " + path));
+    struct stat sb;
+    if (stat(path.c_str(), &sb) == 0) res.bytes = static_cast<int64_t>(sb.st_size);
+    return res;
+}
+
+// ----------------------------------------------------------------
+// Fetch borrow history for a user; full history adds archived loans
+// ----------------------------------------------------------------
+void fetchBorrowHistory(int userID, bool fullHistory) {
+    const char* recent_sql = R"SQL(
+        SELECT b.title,l.borrow_date,IFNULL(l.return_date,0)
           FROM loans l
           JOIN books b ON l.book_id=b.id
          WHERE l.user_id=?;
     )SQL";
+    const char* full_sql = R"SQL(
+        SELECT b.title,l.borrow_date,IFNULL(l.return_date,0)
+          FROM (SELECT id,book_id,borrow_date,return_date FROM main.loans WHERE user_id=?1
+                UNION ALL
+                SELECT id,book_id,borrow_date,return_date FROM archive.loans WHERE user_id=?1) l
+          JOIN books b ON l.book_id=b.id
+         ORDER BY l.id;
+    )SQL";
     try {
-        Stmt stmt(db,sql);
-        sqlite3_bind_int(stmt.stmt,1,userID);
-        while (sqlite3_step(stmt.stmt)==SQLITE_ROW) {
-            cout<<"Title: "<<sqlite3_column_text(stmt.stmt,0)
-                <<", Borrowed: "<<sqlite3_column_text(stmt.stmt,1)
-                <<", Returned: "<<(sqlite3_column_type(stmt.stmt,2)==SQLITE_NULL?"Not yet":(const char*)sqlite3_column_text(stmt.stmt,2))
-                <<endl;
-        }
+        Stmt stmt(db, fullHistory && archiveReady ? full_sql : recent_sql);
+        stmt.bind(userID);
+        stmt.forEach<string_view, int, int>(
+            [](string_view title, int borrowed, int returned) {
+                cout<<"Title: "<<title
+                    <<", Borrowed: "<<dayToDate(borrowed)
+                    <<", Returned: "<<(returned ? dayToDate(returned) : "Not yet")
+                    <<endl;
+            });
     } catch (...) {
         showErrorMessage("Failed to fetch history.");
     }
 }
 
 // ----------------------------------------------------------------
-// Show overdue count for a user
+// Patron summary: one row of user_circ, maintained by loan triggers
+// and the daily sweep instead of aggregating loans per request
 // ----------------------------------------------------------------
-void fetchOverdueStatus(int userID) {
-	const char* sql = R"SQL(
-	        SELECT COUNT(*) FROM loans
-	        WHERE user_id = ? AND return_date IS NULL AND DATE(borrow_date, '+14 days') < DATE('now');
-	    )SQL";
-	    sqlite3_stmt* stmt;
-	    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-	        sqlite3_bind_int(stmt, 1, userID);
-
-	        if (sqlite3_step(stmt) == SQLITE_ROW) {
-	            int count = sqlite3_column_int(stmt, 0);
-	            if (count > 0) {
+Result<PatronSummary> fetchPatronSummary(int userID) {
+    Stmt stmt(db, R"SQL(
+        SELECT open_loans, overdue, lifetime_loans, last_activity
+          FROM user_circ WHERE user_id=?;
+    )SQL", nothrow);
+    if (!stmt.ok()) return dbError(db, stmt.rc);
+    stmt.bind(userID);
+    PatronSummary sum;
+    int rc = stmt.step();
+    if (rc == SQLITE_ROW) {
+        int lastDay = 0;
+        stmt.into(sum.openLoans, sum.overdue, sum.lifetimeLoans, lastDay);
+        if (lastDay) sum.lastActivity = dayToDate(lastDay);
+    } else if (rc != SQLITE_DONE) {
+        return dbError(db, rc);
+    }
+    return sum;   // no row yet: never borrowed
+}
 
-	                showErrorMessage("You have " + to_string(count) + " overdue items.");
-	            }
+Status runOverdueSweep() {
+    BusyScope scope(OpClass::Maintenance);
+    if (!sweepOverdue(db)) return dbError(db, sqlite3_errcode(db));
+    return Status();
+}
 
-	        }
-	        sqlite3_finalize(stmt);
-	    }
+// ----------------------------------------------------------------
+// Show overdue count for a user
+// ----------------------------------------------------------------
+void fetchOverdueStatus(int userID) {
+    Result<PatronSummary> sum = fetchPatronSummary(userID);
+    if (sum && sum.value().overdue > 0) {
+        showErrorMessage("You have " + to_string(sum.value().overdue) + " overdue items.");
+    }
 }
 
 // ----------------------------------------------------------------
 // Register a new user with name, role, username, password
 // ----------------------------------------------------------------
+Status tryRegisterUser(const string& name, const string& role,
+                       const string& username, const string& password)
+{
+    return execWrite("INSERT INTO users(name,role,username,password) VALUES(?,?,?,?);",
+                     name, role, username, password);
+}
+
 bool registerUser(const string& name, const string& role,
                   const string& username, const string& password)
 {
-    const char* sql = "INSERT INTO users(name,role,username,password) VALUES(?,?,?,?);";
-    try {
-        Stmt stmt(db,sql);
-        sqlite3_bind_text(stmt.stmt,1,name.c_str(),-1,SQLITE_STATIC);
-        sqlite3_bind_text(stmt.stmt,2,role.c_str(),-1,SQLITE_STATIC);
-        sqlite3_bind_text(stmt.stmt,3,username.c_str(),-1,SQLITE_STATIC);
-        sqlite3_bind_text(stmt.stmt,4,password.c_str(),-1,SQLITE_STATIC);
-        if (sqlite3_step(stmt.stmt)!=SQLITE_DONE)
-            throw runtime_error(sqlite3_errmsg(db));
-        return true;
-    } catch (const exception& ex) {
-        showErrorMessage(string("User registration failed: ")+ex.what());
-        return false;
-    }
+    Status st = tryRegisterUser(name, role, username, password);
+    if (!st) showErrorMessage("User registration failed: " + st.error().message());
+    return st.ok();
 }
@@ -0,0 +1,152 @@
+// sources/federated.cpp
+
+#include "federated.h"
+#include "stmt.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+using namespace std;
+
+bool rankedBefore(const ShardHit& a, const ShardHit& b) {
+    if (a.rank != b.rank) return a.rank < b.rank;
+    int c = sqlite3_stricmp(a.book.title.c_str(), b.book.title.c_str());
+    if (c != 0) return c < 0;
+    if (a.branchID != b.branchID) return a.branchID < b.branchID;
+    return a.book.id < b.book.id;
+}
+
+namespace {
+
+// One shard: its connection is only ever used on its worker thread
+struct ShardWorker {
+    int                            branchID = 0;
+    sqlite3*                       conn = nullptr;
+    mutex                          m;
+    condition_variable             cv;
+    deque<function<void()>>        jobs;
+    bool                           stopping = false;
+    thread                         worker;
+
+    ShardWorker(const Shard& s) : branchID(s.branchID) {
+        if (sqlite3_open_v2(s.path.c_str(), &conn, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+            sqlite3_close(conn);
+            conn = nullptr;
+            return;
+        }
+        sqlite3_busy_timeout(conn, 250);
+        worker = thread([this] { run(); });
+    }
+    ~ShardWorker() {
+        {
+            lock_guard<mutex> g(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+        if (conn) sqlite3_close(conn);
+    }
+
+    void post(function<void()> job) {
+        {
+            lock_guard<mutex> g(m);
+            jobs.push_back(move(job));
+        }
+        cv.notify_one();
+    }
+
+    void run() {
+        unique_lock<mutex> g(m);
+        for (;;) {
+            cv.wait(g, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;   // stopping, and nothing left
+            function<void()> job = move(jobs.front());
+            jobs.pop_front();
+            g.unlock();
+            job();
+            g.lock();
+        }
+    }
+
+    // Best limit hits on this shard, in rankedBefore order
+    vector<ShardHit> search(const string& keyword, size_t limit) {
+        vector<ShardHit> out;
+        Stmt s(conn, R"SQL(
+            SELECT b.id, b.title, a.name, b.isbn, b.year, b.quantity,
+                   CASE WHEN b.title LIKE ?2 THEN 0 WHEN b.title LIKE ?1 THEN 1 ELSE 2 END AS rank
+              FROM books b JOIN authors a ON a.id=b.author_id
+             WHERE b.title LIKE ?1 OR a.name LIKE ?1
+             ORDER BY rank, b.title COLLATE NOCASE, b.id LIMIT ?3;
+        )SQL", nothrow);
+        if (!s.ok()) return out;
+        s.bind("%" + keyword + "%", keyword + "%", static_cast<long long>(limit));
+        while (s.step() == SQLITE_ROW) {
+            ShardHit h;
+            h.branchID = branchID;
+            s.into(h.book.id, h.book.title, h.book.author, h.book.isbn, h.book.year, h.book.quantity, h.rank);
+            out.push_back(move(h));
+        }
+        return out;
+    }
+};
+
+} // namespace
+
+struct FederatedSearch::Impl {
+    vector<unique_ptr<ShardWorker>> shards;
+};
+
+FederatedSearch::FederatedSearch(const vector<Shard>& shards) : impl(new Impl) {
+    for (const Shard& s : shards) impl->shards.emplace_back(new ShardWorker(s));
+}
+
+FederatedSearch::~FederatedSearch() = default;
+
+bool FederatedSearch::ok() const {
+    for (const auto& s : impl->shards)
+        if (!s->conn) return false;
+    return true;
+}
+
+size_t FederatedSearch::size() const { return impl->shards.size(); }
+
+vector<ShardHit> FederatedSearch::search(const string& keyword, size_t limit) {
+    // Fan out: every shard runs its query at the same time
+    vector<future<vector<ShardHit>>> pending;
+    for (auto& s : impl->shards) {
+        if (!s->conn) continue;
+        ShardWorker* w = s.get();
+        auto task = make_shared<packaged_task<vector<ShardHit>()>>(
+            [w, keyword, limit] { return w->search(keyword, limit); });
+        pending.push_back(task->get_future());
+        w->post([task] { (*task)(); });
+    }
+    vector<vector<ShardHit>> lists;
+    lists.reserve(pending.size());
+    for (auto& f : pending) lists.push_back(f.get());
+
+    // k-way merge: a heap holds the head of each sorted list
+    struct Head {
+        size_t list;
+        size_t pos;
+    };
+    auto after = [&lists](const Head& a, const Head& b) {
+        return rankedBefore(lists[b.list][b.pos], lists[a.list][a.pos]);
+    };
+    priority_queue<Head, vector<Head>, decltype(after)> heads(after);
+    for (size_t i = 0; i < lists.size(); ++i)
+        if (!lists[i].empty()) heads.push(Head{ i, 0 });
+
+    vector<ShardHit> out;
+    while (!heads.empty() && out.size() < limit) {
+        Head h = heads.top();
+        heads.pop();
+        out.push_back(move(lists[h.list][h.pos]));
+        if (++h.pos < lists[h.list].size()) heads.push(h);
+    }
+    return out;
+}
@@ -0,0 +1,428 @@
+// sources/http_server.cpp
+
+#include "http.h"
+#include "json.h"
+#include "core.h"
+#include "epoll_loop.h"
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const size_t maxHeaderBytes = 16 * 1024;
+const size_t maxPendingOut  = 4u << 20;   // stop reading a client this far behind
+const int    defaultLimit   = 100;        // search results per response
+const int    maxLimit       = 1000;
+
+// closing: the last response went out with Connection: close
+using Conn = StreamConn;
+
+// ----------------------------------------------------------------
+// Request parsing helpers
+// ----------------------------------------------------------------
+bool equalsNoCase(string_view a, string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) return false;
+    return true;
+}
+
+string_view trim(string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+// The parts of a request head the server acts on
+struct RequestHead {
+    string_view method;
+    string_view target;
+    bool        keepAlive = false;
+    size_t      length    = 0;   // Content-Length
+    int         error     = 0;   // status to reject the request with
+};
+
+// head: request line and headers, up to and including the blank line
+RequestHead parseHead(string_view head) {
+    RequestHead r;
+    size_t lineEnd = head.find("\r\n");
+    string_view line = head.substr(0, lineEnd);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = sp1 == string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+    if (sp2 == string_view::npos) {
+        r.error = 400;
+        return r;
+    }
+    r.method    = line.substr(0, sp1);
+    r.target    = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    r.keepAlive = line.substr(sp2 + 1) == "HTTP/1.1";
+    for (size_t p = lineEnd + 2; p < head.size(); ) {
+        size_t e = head.find("\r\n", p);
+        string_view h = head.substr(p, e - p);
+        p = e + 2;
+        size_t colon = h.find(':');
+        if (colon == string_view::npos) continue;
+        string_view name = h.substr(0, colon), value = trim(h.substr(colon + 1));
+        if (equalsNoCase(name, "connection")) {
+            if (equalsNoCase(value, "close"))      r.keepAlive = false;
+            if (equalsNoCase(value, "keep-alive")) r.keepAlive = true;
+        } else if (equalsNoCase(name, "content-length")) {
+            r.length = strtoul(string(value).c_str(), nullptr, 10);
+        } else if (equalsNoCase(name, "transfer-encoding")) {
+            r.error = 501;
+            return r;
+        }
+    }
+    if (r.length > maxHeaderBytes) r.error = 400;   // bodies are skipped, never this large
+    return r;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Percent-decoding for query values ('+' is a space)
+string urlDecode(string_view s) {
+    string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '+') {
+            out += ' ';
+        } else if (s[i] == '%' && i + 2 < s.size() && hexValue(s[i + 1]) >= 0 && hexValue(s[i + 2]) >= 0) {
+            out += static_cast<char>(hexValue(s[i + 1]) * 16 + hexValue(s[i + 2]));
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+// Value of name in a query string, decoded; empty if absent
+string queryParam(string_view query, string_view name) {
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        string_view pair = query.substr(0, amp);
+        size_t eq = pair.find('=');
+        if (pair.substr(0, eq) == name) return eq == string_view::npos ? string() : urlDecode(pair.substr(eq + 1));
+        if (amp == string_view::npos) break;
+        query.remove_prefix(amp + 1);
+    }
+    return string();
+}
+
+// Positive decimal id, or 0
+int parseID(string_view s) {
+    if (s.empty() || s.size() > 9) return 0;
+    int v = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') return 0;
+        v = v * 10 + (c - '0');
+    }
+    return v;
+}
+
+const char* reason(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 431: return "Request Header Fields Too Large";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default:  return "Internal Server Error";
+    }
+}
+
+int statusFor(ErrorCode code) {
+    switch (code) {
+        case ErrorCode::NotFound:   return 404;
+        case ErrorCode::NoCopies:   return 404;
+        case ErrorCode::Constraint: return 400;
+        case ErrorCode::Busy:       return 503;
+        default:                  return 500;
+    }
+}
+
+int errorBody(string& body, int status, const string& message) {
+    body.clear();
+    JsonWriter(body).beginObject().field("error", message).endObject();
+    return status;
+}
+
+// ----------------------------------------------------------------
+// Routes: fill body with JSON and return the HTTP status
+// ----------------------------------------------------------------
+int route(string_view path, string_view query, string& body) {
+    StorageEngine* storage = getStorage();
+    if (!storage) return errorBody(body, 503, "database is not open");
+    JsonWriter json(body);
+
+    if (path == "/books/search") {
+        string q = queryParam(query, "q");
+        string lim = queryParam(query, "limit");
+        int limit = lim.empty() ? defaultLimit : atoi(lim.c_str());
+        if (limit <= 0 || limit > maxLimit) return errorBody(body, 400, "limit must be 1.." + to_string(maxLimit));
+        Result<BookList> r = searchBooks(q);
+        if (!r) return errorBody(body, statusFor(r.code()), r.error().message());
+        const vector<Book>& books = *r.value();
+        json.beginArray();
+        for (size_t i = 0; i < books.size() && i < static_cast<size_t>(limit); ++i) json.book(books[i]);
+        json.endArray();
+        return 200;
+    }
+
+    // Reports read the replica when the server started one
+    if (path == "/reports/top-titles" || path == "/reports/daily") {
+        string d = queryParam(query, "days");
+        int days = d.empty() ? 30 : atoi(d.c_str());
+        if (days <= 0 || days > 3660) return errorBody(body, 400, "days must be 1..3660");
+        if (path == "/reports/daily") {
+            Result<vector<DayCount>> r = reportDailyCirculation(days);
+            if (!r) return errorBody(body, statusFor(r.code()), r.error().message());
+            json.beginArray();
+            for (const DayCount& c : r.value())
+                json.beginObject().field("date", dayToDate(c.day)).field("borrowed", c.borrowed)
+                    .field("returned", c.returned).endObject();
+            json.endArray();
+            return 200;
+        }
+        string lim = queryParam(query, "limit");
+        int limit = lim.empty() ? 20 : atoi(lim.c_str());
+        if (limit <= 0 || limit > maxLimit) return errorBody(body, 400, "limit must be 1.." + to_string(maxLimit));
+        Result<vector<TitleCount>> r = reportTopTitles(days, limit);
+        if (!r) return errorBody(body, statusFor(r.code()), r.error().message());
+        json.beginArray();
+        for (const TitleCount& t : r.value())
+            json.beginObject().field("id", t.bookID).field("title", t.title)
+                .field("author", t.author).field("loans", t.loans).endObject();
+        json.endArray();
+        return 200;
+    }
+
+    if (path == "/branches") {
+        json.beginArray();
+        for (const Branch& b : listBranches())
+            json.beginObject().field("id", b.id).field("name", b.name).endObject();
+        json.endArray();
+        return 200;
+    }
+
+    // Every branch file at once, merged by rank
+    if (path == "/branches/search") {
+        string q = queryParam(query, "q");
+        string lim = queryParam(query, "limit");
+        int limit = lim.empty() ? defaultLimit : atoi(lim.c_str());
+        if (limit <= 0 || limit > maxLimit) return errorBody(body, 400, "limit must be 1.." + to_string(maxLimit));
+        Result<vector<ShardHit>> r = searchAllBranches(q, static_cast<size_t>(limit));
+        if (!r) return errorBody(body, statusFor(r.code()), r.error().message());
+        json.beginArray();
+        for (const ShardHit& h : r.value())
+            json.beginObject().field("branch", h.branchID).field("rank", h.rank)
+                .key("book").book(h.book).endObject();
+        json.endArray();
+        return 200;
+    }
+
+    // Copies of one title per branch, and the closest one to from
+    if (path == "/branches/availability") {
+        string isbn = queryParam(query, "isbn");
+        string f = queryParam(query, "from");
+        int from = f.empty() ? 1 : parseID(f);
+        Result<vector<BranchStock>> r = fetchBranchAvailability(isbn);
+        if (!r) return errorBody(body, statusFor(r.code()), r.error().message());
+        Result<NearestCopy> near = findNearestCopy(isbn, from);
+        if (!near && near.code() != ErrorCode::NoCopies)
+            return errorBody(body, statusFor(near.code()), near.error().message());
+        json.beginObject().key("branches").beginArray();
+        for (const BranchStock& b : r.value())
+            json.beginObject().field("id", b.branchID).field("available", b.available).endObject();
+        json.endArray().key("nearest");
+        if (near) json.value(near.value().branchID);
+        else      json.null();
+        json.endObject();
+        return 200;
+    }
+
+    // /books/<id>[/availability] and /patrons/<id>/loans
+    string_view rest = path;
+    bool patron = false;
+    if (rest.substr(0, 7) == "/books/") {
+        rest.remove_prefix(7);
+    } else if (rest.substr(0, 9) == "/patrons/") {
+        rest.remove_prefix(9);
+        patron = true;
+    } else {
+        return errorBody(body, 404, "no such endpoint");
+    }
+    size_t slash = rest.find('/');
+    int id = parseID(rest.substr(0, slash));
+    string_view tail = slash == string_view::npos ? string_view() : rest.substr(slash);
+    if (!id) return errorBody(body, 404, "no such endpoint");
+
+    if (patron && tail == "/loans") {
+        vector<Loan> loans = storage->loans().byUser(id);
+        json.beginArray();
+        for (const Loan& l : loans) json.loan(l);
+        json.endArray();
+        return 200;
+    }
+    if (!patron && tail.empty()) {
+        Book b;
+        if (!storage->books().findByID(id, b)) return errorBody(body, 404, "no book with that ID");
+        json.book(b);
+        return 200;
+    }
+    if (!patron && tail == "/also-borrowed") {
+        Result<BookDetails> r = fetchBookDetails(id);
+        if (!r) return errorBody(body, statusFor(r.code()), r.error().message());
+        json.beginArray();
+        for (const Book& b : r.value().alsoBorrowed) json.book(b);
+        json.endArray();
+        return 200;
+    }
+    if (!patron && tail == "/availability") {
+        Result<Availability> r = fetchAvailability(id);
+        if (!r) return errorBody(body, statusFor(r.code()), r.error().message());
+        const Availability& a = r.value();
+        json.beginObject().field("id", id).field("available", a.available)
+            .field("copies", a.copies).field("holds", a.holds).endObject();
+        return 200;
+    }
+    return errorBody(body, 404, "no such endpoint");
+}
+
+void appendResponse(Conn& c, int status, const string& body, bool keepAlive) {
+    c.out += "HTTP/1.1 ";
+    c.out += to_string(status);
+    c.out += ' ';
+    c.out += reason(status);
+    c.out += "\r\nContent-Type: application/json\r\nContent-Length: ";
+    c.out += to_string(body.size());
+    c.out += keepAlive ? "\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+    c.out += body;
+}
+
+} // namespace
+
+// ================================================================
+// Event loop: EpollLoop with HTTP/1.1 requests
+// ================================================================
+struct HttpServer::Impl {
+    unique_ptr<EpollLoop<Conn, Impl>> loop;
+    int                               boundPort = 0;
+    string                            body;   // reused for every response
+
+    explicit Impl(int port) {
+        int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) return;
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof addr;
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0 ||
+            listen(listenFd, 128) != 0 ||
+            getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+            ::close(listenFd);
+            return;
+        }
+        boundPort = ntohs(addr.sin_port);
+        loop.reset(new EpollLoop<Conn, Impl>(listenFd, *this));
+    }
+
+    void accepted(Conn& c) {
+        int one = 1;
+        setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    }
+
+    // Answer every complete request in order; true if it stopped
+    // because the output backed up
+    bool serve(Conn& c) {
+        size_t pos = 0;
+        bool backedUp = false;
+        while (!c.closing) {
+            if (c.out.size() - c.outPos >= maxPendingOut) {
+                backedUp = true;
+                break;
+            }
+            size_t end = c.in.find("\r\n\r\n", pos);
+            if (end == string::npos) {
+                if (c.in.size() - pos > maxHeaderBytes) reject(c, 431);
+                break;
+            }
+            RequestHead head = parseHead(string_view(c.in).substr(pos, end + 4 - pos));
+            if (head.error) {
+                reject(c, head.error);
+                break;
+            }
+            if (head.length > c.in.size() - end - 4) break;   // body still arriving
+            handle(c, head);
+            pos = end + 4 + head.length;
+        }
+        c.in.erase(0, pos);
+        return backedUp;
+    }
+
+    // The first request in c.in has arrived whole (head and body), or
+    // its head is bad and serve() would reject it
+    bool requestReady(const Conn& c) const {
+        size_t end = c.in.find("\r\n\r\n");
+        if (end == string::npos) return c.in.size() > maxHeaderBytes;
+        RequestHead head = parseHead(string_view(c.in).substr(0, end + 4));
+        return head.error || head.length <= c.in.size() - end - 4;
+    }
+
+    // One request; its body (Content-Length bytes) is skipped
+    void handle(Conn& c, const RequestHead& head) {
+        int status;
+        if (head.method != "GET") {
+            status = errorBody(body, 405, "only GET is supported");
+        } else {
+            size_t q = head.target.find('?');
+            string_view path  = head.target.substr(0, q);
+            string_view query = q == string_view::npos ? string_view() : head.target.substr(q + 1);
+            body.clear();
+            status = route(path, query, body);
+        }
+        appendResponse(c, status, body, head.keepAlive);
+        if (!head.keepAlive) c.closing = true;
+    }
+
+    // Answer with an error and close: the stream cannot be resynced
+    void reject(Conn& c, int status) {
+        errorBody(body, status, reason(status));
+        appendResponse(c, status, body, false);
+        c.closing = true;
+    }
+};
+
+HttpServer::HttpServer(int port) : impl(new Impl(port)) {}
+
+HttpServer::~HttpServer() = default;
+
+bool HttpServer::ok() const { return impl->loop && impl->loop->ok(); }
+
+int HttpServer::port() const { return impl->boundPort; }
+
+bool HttpServer::run() { return impl->loop && impl->loop->run(); }
+
+void HttpServer::stop() {
+    if (impl->loop) impl->loop->stop();
+}
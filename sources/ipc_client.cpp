@@ -0,0 +1,260 @@
+// sources/ipc_client.cpp
+
+#include "ipc.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// ----------------------------------------------------------------
+// Connection and framing
+// ----------------------------------------------------------------
+IpcClient::~IpcClient() {
+    close();
+}
+
+Status IpcClient::connect(const string& socketPath) {
+    close();
+    sockaddr_un addr{};
+    if (socketPath.size() >= sizeof addr.sun_path)
+        return Error(ErrorCode::Database, "socket path too long");
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return Error(ErrorCode::Database, strerror(errno));
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0) {
+        Error err(ErrorCode::Database, "connect " + socketPath + ": " + strerror(errno));
+        close();
+        return err;
+    }
+    return Status();
+}
+
+void IpcClient::close() {
+    if (fd >= 0) ::close(fd);
+    fd    = -1;
+    user  = -1;
+    admin = false;
+}
+
+IpcWriter IpcClient::request(IpcOp op) {
+    IpcWriter w;
+    w.u32(nextID++);
+    w.u8(static_cast<uint8_t>(op));
+    return w;
+}
+
+// Blocking read of exactly n bytes
+static bool readAll(int fd, char* p, size_t n) {
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r > 0) {
+            p += r;
+            n -= static_cast<size_t>(r);
+        } else if (r == 0 || errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w > 0) {
+            p += w;
+            n -= static_cast<size_t>(w);
+        } else if (w < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Status IpcClient::call(IpcWriter& req, IpcReader& in) {
+    if (fd < 0) return Error(ErrorCode::Database, "not connected");
+    const string& frame = req.frame();
+    IpcReader sent(frame.data() + 4, frame.size() - 4);
+    uint32_t id = sent.u32();
+
+    char hdr[4];
+    bool ok = writeAll(fd, frame.data(), frame.size()) && readAll(fd, hdr, sizeof hdr);
+    uint32_t len = ok ? IpcReader(hdr, 4).u32() : 0;
+    ok = ok && len >= 5 && len <= ipcMaxFrame;
+    if (ok) {
+        reply.resize(len);
+        ok = readAll(fd, &reply[0], len);
+    }
+    if (!ok) {
+        close();
+        return Error(ErrorCode::Database, "connection to server lost");
+    }
+
+    in = IpcReader(reply.data(), reply.size());
+    if (in.u32() != id) {
+        close();
+        return Error(ErrorCode::Database, "response out of order");
+    }
+    ErrorCode code = static_cast<ErrorCode>(in.u8());
+    if (code != ErrorCode::Ok) return Error(code, in.str());
+    return Status();
+}
+
+// ----------------------------------------------------------------
+// Operations
+// ----------------------------------------------------------------
+Status IpcClient::login(const string& username, const string& password) {
+    IpcWriter req = request(IpcOp::Login);
+    req.str(username);
+    req.str(password);
+    IpcReader in;
+    Status st = call(req, in);
+    if (!st) return st;
+    user  = in.i32();
+    admin = in.u8() != 0;
+    return st;
+}
+
+Status IpcClient::logout() {
+    IpcWriter req = request(IpcOp::Logout);
+    IpcReader in;
+    Status st = call(req, in);
+    if (st) {
+        user  = -1;
+        admin = false;
+    }
+    return st;
+}
+
+Result<Book> IpcClient::book(int bookID) {
+    IpcWriter req = request(IpcOp::GetBook);
+    req.i32(bookID);
+    IpcReader in;
+    Status st = call(req, in);
+    if (!st) return st.error();
+    return in.book();
+}
+
+Result<Book> IpcClient::bookByIsbn(const string& isbn) {
+    IpcWriter req = request(IpcOp::FindIsbn);
+    req.str(isbn);
+    IpcReader in;
+    Status st = call(req, in);
+    if (!st) return st.error();
+    return in.book();
+}
+
+Result<vector<Book>> IpcClient::books(IpcWriter& req) {
+    IpcReader in;
+    Status st = call(req, in);
+    if (!st) return st.error();
+    uint32_t n = in.u32();
+    if (n > reply.size()) return Error(ErrorCode::Database, "malformed response");
+    vector<Book> out(n);
+    for (Book& b : out) b = in.book();
+    if (!in.done()) return Error(ErrorCode::Database, "malformed response");
+    return out;
+}
+
+Result<vector<Book>> IpcClient::search(const string& keyword) {
+    IpcWriter req = request(IpcOp::Search);
+    req.str(keyword);
+    return books(req);
+}
+
+Result<vector<Book>> IpcClient::booksByAuthor(const string& author) {
+    IpcWriter req = request(IpcOp::ByAuthor);
+    req.str(author);
+    return books(req);
+}
+
+Status IpcClient::addBook(const string& title, const string& author,
+                          const string& isbn, int year, int quantity) {
+    IpcWriter req = request(IpcOp::AddBook);
+    req.str(title);
+    req.str(author);
+    req.str(isbn);
+    req.i32(year);
+    req.i32(quantity);
+    IpcReader in;
+    return call(req, in);
+}
+
+Status IpcClient::editBook(int bookID, const string& title, const string& author) {
+    IpcWriter req = request(IpcOp::EditBook);
+    req.i32(bookID);
+    req.str(title);
+    req.str(author);
+    IpcReader in;
+    return call(req, in);
+}
+
+Status IpcClient::deleteBook(int bookID) {
+    IpcWriter req = request(IpcOp::DeleteBook);
+    req.i32(bookID);
+    IpcReader in;
+    return call(req, in);
+}
+
+Status IpcClient::borrow(int bookID) {
+    IpcWriter req = request(IpcOp::Borrow);
+    req.i32(bookID);
+    IpcReader in;
+    return call(req, in);
+}
+
+Status IpcClient::returnBook(int bookID) {
+    IpcWriter req = request(IpcOp::Return);
+    req.i32(bookID);
+    IpcReader in;
+    return call(req, in);
+}
+
+Result<int> IpcClient::placeHold(int bookID, int priority) {
+    IpcWriter req = request(IpcOp::PlaceHold);
+    req.i32(bookID);
+    req.i32(priority);
+    IpcReader in;
+    Status st = call(req, in);
+    if (!st) return st.error();
+    return in.i32();
+}
+
+Status IpcClient::cancelHold(int bookID) {
+    IpcWriter req = request(IpcOp::CancelHold);
+    req.i32(bookID);
+    IpcReader in;
+    return call(req, in);
+}
+
+Result<vector<Loan>> IpcClient::loans(int userID) {
+    IpcWriter req = request(IpcOp::Loans);
+    req.i32(userID);
+    IpcReader in;
+    Status st = call(req, in);
+    if (!st) return st.error();
+    uint32_t n = in.u32();
+    if (n > reply.size()) return Error(ErrorCode::Database, "malformed response");
+    vector<Loan> out(n);
+    for (Loan& l : out) l = in.loan();
+    if (!in.done()) return Error(ErrorCode::Database, "malformed response");
+    return out;
+}
+
+Result<PatronSummary> IpcClient::summary(int userID) {
+    IpcWriter req = request(IpcOp::Summary);
+    req.i32(userID);
+    IpcReader in;
+    Status st = call(req, in);
+    if (!st) return st.error();
+    PatronSummary s;
+    s.openLoans     = in.i32();
+    s.overdue       = in.i32();
+    s.lifetimeLoans = in.i32();
+    s.lastActivity  = in.str();
+    return s;
+}
@@ -0,0 +1,265 @@
+// sources/ipc_server.cpp
+
+#include "ipc.h"
+#include "epoll_loop.h"
+#include <cstring>
+#include <memory>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// ----------------------------------------------------------------
+// One client connection: its buffers (StreamConn) and its login
+// ----------------------------------------------------------------
+struct Conn : StreamConn {
+    bool loggedIn = false;
+    int  userID   = -1;
+    bool admin    = false;
+};
+
+// Stop reading a client whose unread responses exceed this
+const size_t maxPendingOut = 4u << 20;
+
+Status needLogin(const Conn& c) {
+    return c.loggedIn ? Status() : Status(ErrorCode::NotLoggedIn);
+}
+Status needAdmin(const Conn& c) {
+    if (!c.loggedIn) return ErrorCode::NotLoggedIn;
+    return c.admin ? Status() : Status(Error(ErrorCode::NotLoggedIn, "admin login required"));
+}
+Status needSelf(const Conn& c, int userID) {
+    if (!c.loggedIn) return ErrorCode::NotLoggedIn;
+    return c.admin || c.userID == userID ? Status() : Status(Error(ErrorCode::NotLoggedIn, "not your account"));
+}
+
+template <typename T>
+Status toStatus(const Result<T>& r) {
+    return r ? Status() : Status(r.error());
+}
+
+// Run one request against the core layer on behalf of c
+Status dispatch(Conn& c, IpcOp op, IpcReader& in, IpcWriter& out) {
+    StorageEngine* storage = getStorage();
+    if (!storage) return Error(ErrorCode::Database, "database is not open");
+
+    switch (op) {
+    case IpcOp::Login: {
+        string user = in.str(), pass = in.str();
+        if (!in.done()) break;
+        Status st = tryLoginUser(user, pass);
+        if (!st) return st;
+        c.loggedIn = true;
+        c.userID   = getCurrentUserID();
+        c.admin    = isUserAdmin();
+        out.i32(c.userID);
+        out.u8(c.admin ? 1 : 0);
+        return st;
+    }
+    case IpcOp::Logout:
+        if (!in.done()) break;
+        c.loggedIn = false;
+        c.userID   = -1;
+        c.admin    = false;
+        return Status();
+
+    case IpcOp::GetBook: {
+        int bookID = in.i32();
+        if (!in.done()) break;
+        Book b;
+        if (!storage->books().findByID(bookID, b)) return ErrorCode::NotFound;
+        out.book(b);
+        return Status();
+    }
+    case IpcOp::FindIsbn: {
+        string isbn = in.str();
+        if (!in.done()) break;
+        Result<Book> r = findBookByIsbn(isbn);
+        if (r) out.book(r.value());
+        return toStatus(r);
+    }
+    case IpcOp::Search: {
+        string keyword = in.str();
+        if (!in.done()) break;
+        Result<BookList> r = searchBooks(keyword);
+        if (!r) return r.error();
+        out.u32(static_cast<uint32_t>(r.value()->size()));
+        for (const Book& b : *r.value()) out.book(b);
+        return Status();
+    }
+    case IpcOp::ByAuthor: {
+        string author = in.str();
+        if (!in.done()) break;
+        vector<Book> books = storage->books().byAuthor(author);
+        out.u32(static_cast<uint32_t>(books.size()));
+        for (const Book& b : books) out.book(b);
+        return Status();
+    }
+
+    case IpcOp::AddBook: {
+        string title = in.str(), author = in.str(), isbn = in.str();
+        int year = in.i32(), quantity = in.i32();
+        if (!in.done()) break;
+        Status st = needAdmin(c);
+        return st ? tryAddBook(title, author, isbn, year, quantity) : st;
+    }
+    case IpcOp::EditBook: {
+        int bookID = in.i32();
+        string title = in.str(), author = in.str();
+        if (!in.done()) break;
+        Status st = needAdmin(c);
+        return st ? tryEditBook(bookID, title, author) : st;
+    }
+    case IpcOp::DeleteBook: {
+        int bookID = in.i32();
+        if (!in.done()) break;
+        Status st = needAdmin(c);
+        return st ? tryDeleteBook(bookID) : st;
+    }
+
+    case IpcOp::Borrow:
+    case IpcOp::Return:
+    case IpcOp::CancelHold: {
+        int bookID = in.i32();
+        if (!in.done()) break;
+        Status st = needLogin(c);
+        if (!st) return st;
+        if (op == IpcOp::Borrow) return tryBorrowBook(bookID);
+        if (op == IpcOp::Return) return tryReturnBook(bookID);
+        return tryCancelHold(bookID);
+    }
+    case IpcOp::PlaceHold: {
+        int bookID = in.i32(), priority = in.i32();
+        if (!in.done()) break;
+        Status st = needLogin(c);
+        if (!st) return st;
+        Result<int> r = tryPlaceHold(bookID, priority);
+        if (r) out.i32(r.value());
+        return toStatus(r);
+    }
+
+    case IpcOp::Loans: {
+        int userID = in.i32();
+        if (!in.done()) break;
+        Status st = needSelf(c, userID);
+        if (!st) return st;
+        vector<Loan> loans = storage->loans().byUser(userID);
+        out.u32(static_cast<uint32_t>(loans.size()));
+        for (const Loan& l : loans) out.loan(l);
+        return st;
+    }
+    case IpcOp::Summary: {
+        int userID = in.i32();
+        if (!in.done()) break;
+        Status st = needSelf(c, userID);
+        if (!st) return st;
+        Result<PatronSummary> r = fetchPatronSummary(userID);
+        if (!r) return r.error();
+        const PatronSummary& s = r.value();
+        out.i32(s.openLoans);
+        out.i32(s.overdue);
+        out.i32(s.lifetimeLoans);
+        out.str(s.lastActivity);
+        return st;
+    }
+    }
+    return Error(ErrorCode::Constraint, "malformed request");
+}
+
+} // namespace
+
+// ================================================================
+// Event loop: EpollLoop with framed requests
+// ================================================================
+struct IpcServer::Impl {
+    string                             path;
+    unique_ptr<EpollLoop<Conn, Impl>>  loop;
+
+    explicit Impl(const string& p) : path(p) {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof addr.sun_path) return;
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) return;
+        unlink(path.c_str());   // stale socket from an earlier run
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0 ||
+            listen(listenFd, 64) != 0) {
+            ::close(listenFd);
+            return;
+        }
+        loop.reset(new EpollLoop<Conn, Impl>(listenFd, *this));
+    }
+    ~Impl() {
+        if (!loop) return;
+        loop.reset();
+        unlink(path.c_str());
+    }
+
+    void accepted(Conn&) {}
+
+    // Answer complete frames in order; true if it stopped because the
+    // output backed up with whole frames still waiting
+    bool serve(Conn& c) {
+        size_t pos = 0;
+        bool   backedUp = false;
+        while (!c.closing && c.in.size() - pos >= 4) {
+            if (c.out.size() - c.outPos >= maxPendingOut) {
+                backedUp = true;
+                break;
+            }
+            IpcReader hdr(c.in.data() + pos, 4);
+            uint32_t len = hdr.u32();
+            if (len > ipcMaxFrame || len < 5) {
+                c.closing = true;
+                break;
+            }
+            if (c.in.size() - pos - 4 < len) break;
+            IpcReader in(c.in.data() + pos + 4, len);
+            uint32_t id = in.u32();
+            IpcOp    op = static_cast<IpcOp>(in.u8());
+            pos += 4 + len;
+
+            // The core layer keeps one login; lend it this client's
+            setLoginState(c.loggedIn, c.userID, c.admin);
+            IpcWriter out;
+            out.u32(id);
+            out.u8(static_cast<uint8_t>(ErrorCode::Ok));
+            Status st = dispatch(c, op, in, out);
+            logoutUser();
+            if (st) {
+                c.out += out.frame();
+            } else {
+                IpcWriter err;
+                err.u32(id);
+                err.u8(static_cast<uint8_t>(st.code()));
+                err.str(st.error().detail);
+                c.out += err.frame();
+            }
+        }
+        c.in.erase(0, pos);
+        return backedUp;
+    }
+
+    bool requestReady(const Conn& c) const {
+        if (c.in.size() < 4) return false;
+        IpcReader hdr(c.in.data(), 4);
+        return c.in.size() - 4 >= hdr.u32();
+    }
+};
+
+IpcServer::IpcServer(const string& socketPath) : impl(new Impl(socketPath)) {}
+
+IpcServer::~IpcServer() = default;
+
+bool IpcServer::ok() const { return impl->loop && impl->loop->ok(); }
+
+bool IpcServer::run() { return impl->loop && impl->loop->run(); }
+
+void IpcServer::stop() {
+    if (impl->loop) impl->loop->stop();
+}
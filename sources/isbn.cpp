@@ -0,0 +1,70 @@
+// sources/isbn.cpp
+
+#include "isbn.h"
+
+using namespace std;
+
+// Copy text without separators into d; returns the length, or 0 if it
+// is not 10 or 13 characters
+static size_t compact(string_view text, char (&d)[13]) {
+    size_t n = 0;
+    for (char c : text) {
+        if (c == '-' || c == ' ') continue;
+        if (n == 13) return 0;
+        d[n++] = c;
+    }
+    return (n == 10 || n == 13) ? n : 0;
+}
+
+static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Rewrite a valid ISBN-10 in d as the 13 digits of its 978 form;
+// false if the ISBN-10 checksum fails
+static bool widen10(char (&d)[13]) {
+    int sum = 0;
+    for (int i = 0; i < 9; ++i) {
+        if (!isDigit(d[i])) return false;
+        sum += (10 - i) * (d[i] - '0');
+    }
+    if (d[9] == 'X' || d[9] == 'x') sum += 10;
+    else if (isDigit(d[9]))         sum += d[9] - '0';
+    else                            return false;
+    if (sum % 11 != 0) return false;
+
+    for (int i = 8; i >= 0; --i) d[i + 3] = d[i];
+    d[0] = '9'; d[1] = '7'; d[2] = '8';
+    int s13 = 0;
+    for (int i = 0; i < 12; ++i) s13 += (i % 2 ? 3 : 1) * (d[i] - '0');
+    d[12] = static_cast<char>('0' + (10 - s13 % 10) % 10);
+    return true;
+}
+
+int64_t normalizeIsbn(string_view text) {
+    char d[13];
+    size_t n = compact(text, d);
+    if (n == 0) return 0;
+    if (n == 10 && !widen10(d)) return 0;
+
+    int sum = 0;
+    int64_t value = 0;
+    for (int i = 0; i < 13; ++i) {
+        if (!isDigit(d[i])) return 0;
+        sum += (i % 2 ? 3 : 1) * (d[i] - '0');
+        value = value * 10 + (d[i] - '0');
+    }
+    int64_t prefix = value / 10000000000LL;
+    if (sum % 10 != 0 || (prefix != 978 && prefix != 979)) return 0;
+    return value;
+}
+
+string isbnText(int64_t isbn13) {
+    string s(13, '0');
+    for (int i = 12; i >= 0 && isbn13 > 0; --i, isbn13 /= 10)
+        s[i] = static_cast<char>('0' + isbn13 % 10);
+    return s;
+}
+
+void normalizeIsbns(const vector<string>& text, vector<int64_t>& out) {
+    out.resize(text.size());
+    for (size_t i = 0; i < text.size(); ++i) out[i] = normalizeIsbn(text[i]);
+}
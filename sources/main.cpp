@@ -2,14 +2,86 @@
 
 #include "core.h"
 #include "ui.h"
+#include "ipc.h"
 #include <FL/Fl.H>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+
+static IpcServer* server = nullptr;
+
+static void stopServer(int) {
+    if (server) server->stop();
+}
+
+// app --serve <socket>: own library.db and serve terminals over IPC
+static int serve(const char* socketPath) {
+    initializeSystem();
+    if (!getStorage()) return 1;
+    startMaintenance();
+    IpcServer s(socketPath);
+    if (!s.ok()) {
+        std::cerr << "Cannot listen on " << socketPath << std::endl;
+        closeSystem();
+        return 1;
+    }
+    server = &s;
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+    bool ok = s.run();
+    server = nullptr;
+    closeSystem();
+    return ok ? 0 : 1;
+}
+
+// app --backup <file> [--compress]: online copy while other instances run
+static int backup(const char* path, bool compress) {
+    initializeSystem();
+    if (!getStorage()) return 1;
+    BackupOptions options;
+    options.compress = compress;
+    BackupResult r = backupDatabase(path, options);
+    closeSystem();
+    if (!r.status) {
+        std::cerr << "Backup failed: " << r.status.error().message() << std::endl;
+        return 1;
+    }
+    std::cout << path << ": " << r.pages << " pages in " << r.seconds << " s ("
+              << static_cast<long>(r.pagesPerSecond) << " pages/s, " << r.steps << " steps)";
+    if (compress) std::cout << ", compressed in " << r.compressSeconds << " s";
+    std::cout << ", " << r.bytes << " bytes" << std::endl;
+    return 0;
+}
+
+// app --recommend: rebuild the "also borrowed" lists from loans
+static int recommend() {
+    initializeSystem();
+    if (!getStorage()) return 1;
+    RecommendStats r = buildRecommendations();
+    closeSystem();
+    if (!r.status) {
+        std::cerr << "Recommendation build failed: " << r.status.error().message() << std::endl;
+        return 1;
+    }
+    std::cout << r.books << " books, " << r.pairs << " pairs from " << r.patrons << " patrons; load "
+              << r.loadSeconds << " s, build " << r.buildSeconds << " s on " << r.threads
+              << " threads, store " << r.storeSeconds << " s" << std::endl;
+    return 0;
+}
 
 int main(int argc, char** argv) {
-    (void)argc;
-    (void)argv;
+    if (argc == 3 && std::strcmp(argv[1], "--serve") == 0) return serve(argv[2]);
+    if ((argc == 3 || (argc == 4 && std::strcmp(argv[3], "--compress") == 0))
+        && std::strcmp(argv[1], "--backup") == 0)
+        return backup(argv[2], argc == 4);
+    if (argc == 2 && std::strcmp(argv[1], "--recommend") == 0) return recommend();
+
     initializeSystem();    // Initialize database & tables
+    startMaintenance();    // Background WAL checkpoints (autocheckpoint if it fails)
+    Fl::lock();            // Let worker threads post updates via Fl::awake
     showLoginWindow();     // Show login UI
     int ret = Fl::run();   // Run FLTK event loop
+    closeScanWindows();    // Finish queued scans
     closeSystem();         // Close DB cleanly
     return ret;            // Return FLTK result
 }
@@ -0,0 +1,193 @@
+// sources/maintenance.cpp
+
+#include "maintenance.h"
+#include "storage.h"
+#include "stmt.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+#include <sqlite3.h>
+
+using namespace std;
+
+using SteadyTime = chrono::steady_clock::time_point;
+
+struct MaintenanceThread::Impl {
+    string             path;
+    MaintenanceConfig  config;
+    sqlite3*           conn = nullptr;
+    mutable mutex      m;             // guards stopping and stats
+    condition_variable cv;
+    bool               stopping = false;
+    MaintenanceStats   st;
+    thread             worker;
+
+    // Worker-only state
+    long long  dataVersion  = -1;
+    bool       unsynced     = true;   // commits seen since the last full checkpoint
+    int        lastFrames   = 0;      // WAL length and frames copied as of the
+    int        lastCopied   = 0;      // previous checkpoint, to count new ones
+    SteadyTime lastCommit   = chrono::steady_clock::now();
+    SteadyTime lastOptimize = chrono::steady_clock::now();
+    int        sweptDay     = 0;
+
+    Impl(const string& p, const MaintenanceConfig& c) : path(p), config(c) {
+        if (sqlite3_open(path.c_str(), &conn) != SQLITE_OK) {
+            sqlite3_close(conn);
+            conn = nullptr;
+            return;
+        }
+        // Checkpoints are this thread's job; no busy handler, so a
+        // locked database skips the task instead of stalling the loop
+        sqlite3_wal_autocheckpoint(conn, 0);
+        sweptDay = todayDay();   // initializeSystem swept already
+        worker = thread([this] { run(); });
+    }
+    ~Impl() {
+        {
+            lock_guard<mutex> g(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+        if (conn) sqlite3_close(conn);
+    }
+
+    void run() {
+        unique_lock<mutex> g(m);
+        auto poll = chrono::milliseconds(config.pollMs > 0 ? config.pollMs : 1);
+        while (!cv.wait_for(g, poll, [this] { return stopping; })) {
+            g.unlock();
+            tick();
+            g.lock();
+        }
+    }
+
+    long long pragma(const char* sql) {
+        Stmt s(conn, sql, nothrow);
+        if (!s.ok() || s.step() != SQLITE_ROW) return -1;
+        return get<0>(s.row<long long>());
+    }
+
+    int64_t walSize() const {
+        struct stat sb;
+        return stat((path + "-wal").c_str(), &sb) == 0 ? static_cast<int64_t>(sb.st_size) : 0;
+    }
+
+    // True if every frame in the WAL made it back into the database;
+    // frames is set to the WAL length
+    bool checkpoint(int mode, int& frames) {
+        int copied = 0;
+        frames = 0;
+        auto start = chrono::steady_clock::now();
+        int rc = sqlite3_wal_checkpoint_v2(conn, "main", mode, &frames, &copied);
+        auto micros = static_cast<uint64_t>(chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - start).count());
+        bool complete = rc == SQLITE_OK && copied >= frames;
+
+        // The counts are totals for the current WAL; a shorter log means
+        // a writer started it over
+        if (frames < lastFrames) lastCopied = 0;
+        int fresh = copied > lastCopied ? copied - lastCopied : 0;
+        lastFrames = frames;
+        lastCopied = copied;
+
+        lock_guard<mutex> g(m);
+        if (mode == SQLITE_CHECKPOINT_PASSIVE)      ++st.checkpoints;
+        else if (!complete)                         ;
+        else if (mode == SQLITE_CHECKPOINT_RESTART) ++st.restarts;
+        else                                        ++st.truncates;
+        if (!complete) ++st.busy;
+        st.framesCopied += static_cast<uint64_t>(fresh);
+        st.walFrames     = frames;
+        st.lastMicros    = micros;
+        st.totalMicros  += micros;
+        if (micros > st.maxMicros) st.maxMicros = micros;
+        return complete;
+    }
+
+    void tick() {
+        auto now = chrono::steady_clock::now();
+        long long version = pragma("PRAGMA data_version;");
+        if (version != dataVersion) {
+            dataVersion = version;
+            lastCommit  = now;
+            unsynced    = true;
+        }
+        int frames = 0;
+        if (unsynced) {
+            unsynced = !checkpoint(SQLITE_CHECKPOINT_PASSIVE, frames);
+            // A writer only rewinds the log if it finds every frame copied
+            // back when its transaction starts, which steady commits never
+            // allow. RESTART makes it so, and after the passive pass it has
+            // only the latest frames to copy. Desks hold the write lock only
+            // briefly, so this one waits a moment for a gap.
+            if (frames >= config.restartFrames) {
+                sqlite3_busy_timeout(conn, 20);
+                unsynced = !checkpoint(SQLITE_CHECKPOINT_RESTART, frames);
+                sqlite3_busy_timeout(conn, 0);
+            }
+        }
+
+        int64_t wal = walSize();
+        bool idle = now - lastCommit >= chrono::milliseconds(config.idleMs);
+        // Shrinking the file holds the write lock for as long as the
+        // filesystem takes (tens of ms for a large WAL), so it waits for
+        // idle time; until then the file keeps its high-water size
+        if (idle && wal > 0) {
+            if (checkpoint(SQLITE_CHECKPOINT_TRUNCATE, frames)) wal = walSize();
+        }
+        {
+            lock_guard<mutex> g(m);
+            st.walBytes = wal;
+        }
+
+        if (todayDay() != sweptDay && sweepOverdue(conn)) {
+            sweptDay = todayDay();
+            lock_guard<mutex> g(m);
+            ++st.sweeps;
+        }
+        if (!idle) return;
+
+        if (now - lastOptimize >= chrono::minutes(config.optimizeMinutes)) {
+            // 0x10002: consider every table, not just ones this connection used
+            if (sqlite3_exec(conn, "PRAGMA analysis_limit=400; PRAGMA optimize=0x10002;",
+                             nullptr, nullptr, nullptr) == SQLITE_OK) {
+                lastOptimize = now;
+                lock_guard<mutex> g(m);
+                ++st.optimizes;
+            }
+        }
+
+        long long freePages = pragma("PRAGMA freelist_count;");
+        uint64_t released = 0;
+        if (freePages > 0 && config.vacuumPages > 0 && pragma("PRAGMA auto_vacuum;") == 2) {
+            string sql = "PRAGMA incremental_vacuum(" + to_string(config.vacuumPages) + ");";
+            if (sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK) {
+                long long left = pragma("PRAGMA freelist_count;");
+                if (left >= 0 && left < freePages) {
+                    released  = static_cast<uint64_t>(freePages - left);
+                    freePages = left;
+                }
+            }
+        }
+        lock_guard<mutex> g(m);
+        st.vacuumedPages += released;
+        st.freePages      = static_cast<int>(max(freePages, 0LL));
+    }
+};
+
+MaintenanceThread::MaintenanceThread(const string& dbPath, const MaintenanceConfig& config)
+    : impl(new Impl(dbPath, config)) {}
+
+MaintenanceThread::~MaintenanceThread() = default;
+
+bool MaintenanceThread::ok() const { return impl->conn != nullptr; }
+
+MaintenanceStats MaintenanceThread::stats() const {
+    lock_guard<mutex> g(impl->m);
+    return impl->st;
+}
@@ -0,0 +1,54 @@
+// sources/opac.cpp
+//
+// Headless web OPAC back end: serves the catalogue as JSON over HTTP
+// (see http.h). Built as its own binary so it does not pull in FLTK.
+
+#include "core.h"
+#include "ui.h"
+#include "http.h"
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+
+// The core layer reports problems through these; without a UI they go to stderr
+void showErrorMessage(const std::string& message) {
+    std::cerr << "Error: " << message << std::endl;
+}
+
+void showSuccessMessage(const std::string& message) {
+    std::cerr << message << std::endl;
+}
+
+static HttpServer* server = nullptr;
+
+static void stopServer(int) {
+    if (server) server->stop();
+}
+
+// opac [port]   (default 8080)
+int main(int argc, char** argv) {
+    int port = argc > 1 ? std::atoi(argv[1]) : 8080;
+    if (port < 0 || port > 65535) {
+        std::cerr << "usage: opac [port]" << std::endl;
+        return 2;
+    }
+
+    initializeSystem();
+    if (!getStorage()) return 1;
+    startMaintenance();
+    startReporting();    // /reports/* read a copy refreshed every minute
+    HttpServer s(port);
+    if (!s.ok()) {
+        std::cerr << "Cannot listen on 127.0.0.1:" << port << std::endl;
+        closeSystem();
+        return 1;
+    }
+    std::cerr << "OPAC listening on http://127.0.0.1:" << s.port() << "/" << std::endl;
+    server = &s;
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+    bool ok = s.run();
+    server = nullptr;
+    closeSystem();
+    return ok ? 0 : 1;
+}
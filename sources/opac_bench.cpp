@@ -0,0 +1,162 @@
+// sources/opac_bench.cpp
+//
+// Local load generator for the OPAC server: keep-alive connections,
+// each with a window of pipelined GETs, against the search and the
+// book-details endpoints in turn. Prints requests/sec for each.
+//
+//   opac_bench [port] [connections] [seconds] [pipeline depth]
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+static const char* keywords[] = { "the", "history", "science", "war", "1", "42", "777", "2024" };
+
+static int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+// Read until n complete responses have arrived, counting the non-200
+// ones in misses; false if the connection fails
+static bool readResponses(int fd, string& buf, int n, long& misses) {
+    char tmp[64 * 1024];
+    while (n > 0) {
+        size_t head = buf.find("\r\n\r\n");
+        if (head != string::npos) {
+            size_t cl = buf.find("Content-Length: ");
+            if (cl == string::npos || cl > head) return false;
+            size_t total = head + 4 + strtoul(buf.c_str() + cl + 16, nullptr, 10);
+            if (buf.size() >= total) {
+                if (buf.compare(0, 12, "HTTP/1.1 200") != 0) ++misses;
+                buf.erase(0, total);
+                --n;
+                continue;
+            }
+        }
+        ssize_t r = read(fd, tmp, sizeof tmp);
+        if (r <= 0) return false;
+        buf.append(tmp, static_cast<size_t>(r));
+    }
+    return true;
+}
+
+// One connection's loop: send depth requests, wait for all, repeat
+static void worker(int port, bool search, int maxBookID, int depth, unsigned seed,
+                   const atomic<bool>& stop, atomic<long>& done, atomic<long>& missed,
+                   atomic<bool>& failed) {
+    int fd = connectTo(port);
+    if (fd < 0) {
+        failed = true;
+        return;
+    }
+    mt19937 rng(seed);
+    string out, in;
+    long count = 0, misses = 0;
+    while (!stop) {
+        out.clear();
+        for (int i = 0; i < depth; ++i) {
+            out += "GET ";
+            if (search) {
+                out += "/books/search?q=";
+                out += keywords[rng() % (sizeof keywords / sizeof *keywords)];
+                out += "&limit=20";
+            } else {
+                out += "/books/" + to_string(1 + rng() % maxBookID);
+            }
+            out += " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        }
+        if (send(fd, out.data(), out.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(out.size()) ||
+            !readResponses(fd, in, depth, misses)) {
+            failed = true;
+            break;
+        }
+        count += depth;
+    }
+    done   += count;
+    missed += misses;
+    close(fd);
+}
+
+static double run(const char* name, int port, bool search, int maxBookID,
+                  int conns, int seconds, int depth) {
+    atomic<bool> stop(false), failed(false);
+    atomic<long> done(0), missed(0);
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < conns; ++i)
+        threads.emplace_back(worker, port, search, maxBookID, depth, 1234u + i,
+                             cref(stop), ref(done), ref(missed), ref(failed));
+    this_thread::sleep_for(chrono::seconds(seconds));
+    stop = true;
+    for (thread& t : threads) t.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double rate = done / secs;
+    cout << name << ": " << done << " requests in " << secs << " s = "
+         << static_cast<long>(rate) << " req/s";
+    if (missed) cout << ", " << missed << " not 200";
+    cout << (failed ? "  (connection errors)" : "") << endl;
+    return rate;
+}
+
+int main(int argc, char** argv) {
+    int port    = argc > 1 ? atoi(argv[1]) : 8080;
+    int conns   = argc > 2 ? atoi(argv[2]) : 8;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+    int depth   = argc > 4 ? atoi(argv[4]) : 16;
+    if (conns <= 0 || seconds <= 0 || depth <= 0) {
+        cerr << "usage: opac_bench [port] [connections] [seconds] [pipeline depth]" << endl;
+        return 2;
+    }
+
+    // Details requests pick IDs in 1..N; find N by bisecting for the
+    // highest book that answers 200 (gaps from deletions show up as misses)
+    int fd = connectTo(port);
+    if (fd < 0) {
+        cerr << "Cannot connect to 127.0.0.1:" << port << endl;
+        return 1;
+    }
+    int lo = 1, hi = 1 << 24;
+    string buf;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        string req = "GET /books/" + to_string(mid) + " HTTP/1.1\r\n\r\n";
+        long miss = 0;
+        if (send(fd, req.data(), req.size(), MSG_NOSIGNAL) < 0 || !readResponses(fd, buf, 1, miss)) {
+            cerr << "Server closed the connection" << endl;
+            return 1;
+        }
+        if (miss) hi = mid - 1;
+        else      lo = mid;
+    }
+    close(fd);
+
+    cout << conns << " connections, pipeline depth " << depth << ", books 1.." << lo << endl;
+    run("search ", port, true,  lo, conns, seconds, depth);
+    run("details", port, false, lo, conns, seconds, depth);
+    return 0;
+}
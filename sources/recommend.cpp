@@ -0,0 +1,146 @@
+// sources/recommend.cpp
+
+#include "recommend.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+// Compressed sparse rows: row r holds cols[offsets[r] .. offsets[r+1])
+struct Csr {
+    vector<uint32_t> offsets;
+    vector<uint32_t> cols;
+};
+
+bool better(const AlsoBorrowed& a, const AlsoBorrowed& b) {
+    if (a.patrons != b.patrons) return a.patrons > b.patrons;
+    return a.bookID < b.bookID;
+}
+
+} // namespace
+
+CoBorrowIndex CoBorrowIndex::build(const vector<pair<int, int>>& pairs, const RecommendConfig& config) {
+    CoBorrowIndex out;
+
+    // Dense book numbers, so the accumulator can be a plain array
+    vector<int> books;
+    books.reserve(pairs.size());
+    for (const auto& p : pairs) books.push_back(p.second);
+    sort(books.begin(), books.end());
+    books.erase(unique(books.begin(), books.end()), books.end());
+    auto dense = [&books](int bookID) {
+        return static_cast<uint32_t>(lower_bound(books.begin(), books.end(), bookID) - books.begin());
+    };
+
+    // A: patron rows; patrons over maxPatronBooks are skipped
+    Csr byPatron;
+    byPatron.offsets.push_back(0);
+    for (size_t i = 0; i < pairs.size(); ) {
+        size_t j = i;
+        while (j < pairs.size() && pairs[j].first == pairs[i].first) ++j;
+        if (j - i >= 2 && (config.maxPatronBooks <= 0 || j - i <= static_cast<size_t>(config.maxPatronBooks))) {
+            for (size_t k = i; k < j; ++k) byPatron.cols.push_back(dense(pairs[k].second));
+            byPatron.offsets.push_back(static_cast<uint32_t>(byPatron.cols.size()));
+        }
+        i = j;
+    }
+    size_t nPatrons = byPatron.offsets.size() - 1;
+    size_t nBooks   = books.size();
+    out.patronCount = static_cast<int>(nPatrons);
+
+    // At: book rows, by a counting pass and a fill pass
+    Csr byBook;
+    byBook.offsets.assign(nBooks + 1, 0);
+    for (uint32_t b : byPatron.cols) ++byBook.offsets[b + 1];
+    for (size_t b = 0; b < nBooks; ++b) byBook.offsets[b + 1] += byBook.offsets[b];
+    byBook.cols.resize(byPatron.cols.size());
+    {
+        vector<uint32_t> next(byBook.offsets.begin(), byBook.offsets.end() - 1);
+        for (size_t p = 0; p < nPatrons; ++p)
+            for (uint32_t k = byPatron.offsets[p]; k < byPatron.offsets[p + 1]; ++k)
+                byBook.cols[next[byPatron.cols[k]]++] = static_cast<uint32_t>(p);
+    }
+
+    size_t topK = static_cast<size_t>(max(config.topK, 1));
+    vector<AlsoBorrowed> kept(nBooks * topK);
+    vector<uint32_t>     keptLength(nBooks, 0);
+
+    unsigned threads = config.threads > 0 ? static_cast<unsigned>(config.threads) : thread::hardware_concurrency();
+    threads = max(1u, min(threads, static_cast<unsigned>(nBooks / 64 + 1)));
+    const uint32_t chunk = 256;
+    atomic<uint32_t> nextRow{0};
+
+    auto work = [&] {
+        vector<uint32_t>     count(nBooks, 0);   // row i of C, dense
+        vector<uint32_t>     touched;
+        vector<AlsoBorrowed> row;
+        for (;;) {
+            uint32_t first = nextRow.fetch_add(chunk);
+            if (first >= nBooks) return;
+            uint32_t last = static_cast<uint32_t>(min<size_t>(first + chunk, nBooks));
+            for (uint32_t i = first; i < last; ++i) {
+                for (uint32_t k = byBook.offsets[i]; k < byBook.offsets[i + 1]; ++k) {
+                    uint32_t p = byBook.cols[k];
+                    for (uint32_t m = byPatron.offsets[p]; m < byPatron.offsets[p + 1]; ++m) {
+                        uint32_t j = byPatron.cols[m];
+                        if (j != i && count[j]++ == 0) touched.push_back(j);
+                    }
+                }
+                row.clear();
+                for (uint32_t j : touched) {
+                    if (count[j] >= static_cast<uint32_t>(config.minPatrons))
+                        row.push_back(AlsoBorrowed{ books[j], static_cast<int>(count[j]) });
+                    count[j] = 0;
+                }
+                touched.clear();
+                size_t n = min(topK, row.size());
+                partial_sort(row.begin(), row.begin() + n, row.end(), better);
+                copy_n(row.begin(), n, kept.begin() + i * topK);
+                keptLength[i] = static_cast<uint32_t>(n);
+            }
+        }
+    };
+    vector<thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(work);
+    work();
+    for (thread& t : pool) t.join();
+
+    // Compact to CSR, leaving out books without neighbours
+    out.offsets.push_back(0);
+    for (size_t i = 0; i < nBooks; ++i) {
+        if (!keptLength[i]) continue;
+        out.keys.push_back(books[i]);
+        out.entries.insert(out.entries.end(), kept.begin() + i * topK, kept.begin() + i * topK + keptLength[i]);
+        out.offsets.push_back(static_cast<uint32_t>(out.entries.size()));
+    }
+    return out;
+}
+
+CoBorrowIndex CoBorrowIndex::fromRows(const vector<pair<int, AlsoBorrowed>>& rows) {
+    CoBorrowIndex out;
+    out.entries.reserve(rows.size());
+    for (const auto& r : rows) {
+        if (out.keys.empty() || out.keys.back() != r.first) {
+            out.keys.push_back(r.first);
+            out.offsets.push_back(static_cast<uint32_t>(out.entries.size()));
+        }
+        out.entries.push_back(r.second);
+    }
+    out.offsets.push_back(static_cast<uint32_t>(out.entries.size()));
+    return out;
+}
+
+pair<const AlsoBorrowed*, size_t> CoBorrowIndex::neighbours(int bookID) const {
+    auto it = lower_bound(keys.begin(), keys.end(), bookID);
+    if (it == keys.end() || *it != bookID) return { nullptr, 0 };
+    size_t r = static_cast<size_t>(it - keys.begin());
+    return { entries.data() + offsets[r], offsets[r + 1] - offsets[r] };
+}
+
+size_t CoBorrowIndex::bytes() const {
+    return keys.capacity() * sizeof(int) + offsets.capacity() * sizeof(uint32_t) +
+           entries.capacity() * sizeof(AlsoBorrowed);
+}
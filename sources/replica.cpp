@@ -0,0 +1,153 @@
+// sources/replica.cpp
+
+#include "replica.h"
+#include "storage.h"
+#include "stmt.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+using SteadyTime = chrono::steady_clock::time_point;
+
+struct ReportReplica::Impl {
+    string                   path;
+    ReplicaConfig            config;
+    sqlite3*                 src = nullptr;   // read-only, worker and refresh() only
+    mutex                    refreshLock;     // one refresh at a time
+    mutable mutex            m;               // guards current, taken, stats, stopping
+    condition_variable       cv;
+    shared_ptr<sqlite3>      current;
+    SteadyTime               taken;
+    long long                copiedVersion = -1;
+    bool                     stopping = false;
+    ReplicaStats             st;
+    thread                   worker;
+
+    Impl(const string& p, const ReplicaConfig& c) : path(p), config(c) {
+        if (sqlite3_open_v2(path.c_str(), &src, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+            sqlite3_close(src);
+            src = nullptr;
+            return;
+        }
+        sqlite3_busy_timeout(src, 1000);
+        refresh(true);
+        worker = thread([this] { run(); });
+    }
+    ~Impl() {
+        {
+            lock_guard<mutex> g(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+        if (src) sqlite3_close(src);
+    }
+
+    void run() {
+        unique_lock<mutex> g(m);
+        auto every = chrono::seconds(config.refreshSeconds > 0 ? config.refreshSeconds : 1);
+        while (!cv.wait_for(g, every, [this] { return stopping; })) {
+            g.unlock();
+            refresh(false);
+            g.lock();
+        }
+    }
+
+    long long dataVersion() {
+        Stmt s(src, "PRAGMA data_version;", nothrow);
+        if (!s.ok() || s.step() != SQLITE_ROW) return -1;
+        return get<0>(s.row<long long>());
+    }
+
+    // A file replica is built beside path and renamed over it
+    sqlite3* openTarget(string& built) {
+        built = config.path.empty() ? ":memory:" : config.path + ".tmp";
+        if (!config.path.empty()) std::remove(built.c_str());
+        sqlite3* conn = nullptr;
+        if (sqlite3_open(built.c_str(), &conn) != SQLITE_OK) {
+            sqlite3_close(conn);
+            return nullptr;
+        }
+        sqlite3_exec(conn, "PRAGMA journal_mode=OFF;", nullptr, nullptr, nullptr);
+        return conn;
+    }
+
+    bool refresh(bool force) {
+        if (!src) return false;
+        lock_guard<mutex> r(refreshLock);
+        long long version = dataVersion();
+        if (!force && version >= 0 && version == copiedVersion) {
+            lock_guard<mutex> g(m);
+            ++st.skipped;
+            taken = chrono::steady_clock::now();   // still matches library.db
+            return true;
+        }
+
+        auto start = chrono::steady_clock::now();
+        string built;
+        sqlite3* conn = openTarget(built);
+        int pages = 0;
+        bool ok = conn && copyDatabase(src, conn, config.pagesPerStep, config.pauseMs, &pages) == SQLITE_OK;
+        if (ok && !config.path.empty()) {
+            // SQLite refuses reads through a handle whose file was renamed,
+            // so the copy is reopened under its final name. Handles on the
+            // copy this one replaces keep reading the old file.
+            sqlite3_close(conn);
+            conn = nullptr;
+            ok = std::rename(built.c_str(), config.path.c_str()) == 0 &&
+                 sqlite3_open_v2(config.path.c_str(), &conn, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK;
+        }
+        if (ok) ok = sqlite3_exec(conn, "PRAGMA query_only=1;", nullptr, nullptr, nullptr) == SQLITE_OK;
+        auto micros = static_cast<uint64_t>(chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - start).count());
+        if (!ok) {
+            sqlite3_close(conn);
+            if (!config.path.empty()) std::remove(built.c_str());
+            lock_guard<mutex> g(m);
+            ++st.failures;
+            return false;
+        }
+
+        copiedVersion = version;
+        shared_ptr<sqlite3> old(conn, sqlite3_close);
+        {
+            lock_guard<mutex> g(m);
+            current.swap(old);
+            taken = start;
+            ++st.refreshes;
+            st.pages      = pages;
+            st.lastMicros = micros;
+            if (micros > st.maxMicros) st.maxMicros = micros;
+        }
+        return true;   // the old copy closes here, or with its last query
+    }
+};
+
+ReportReplica::ReportReplica(const string& dbPath, const ReplicaConfig& config)
+    : impl(new Impl(dbPath, config)) {}
+
+ReportReplica::~ReportReplica() = default;
+
+bool ReportReplica::ok() const {
+    lock_guard<mutex> g(impl->m);
+    return impl->current != nullptr;
+}
+
+shared_ptr<sqlite3> ReportReplica::connection() const {
+    lock_guard<mutex> g(impl->m);
+    return impl->current;
+}
+
+bool ReportReplica::refresh() { return impl->refresh(false); }
+
+ReplicaStats ReportReplica::stats() const {
+    lock_guard<mutex> g(impl->m);
+    ReplicaStats s = impl->st;
+    if (impl->current)
+        s.ageMs = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - impl->taken).count();
+    return s;
+}
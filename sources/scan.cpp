@@ -0,0 +1,198 @@
+// sources/scan.cpp
+
+#include "scan.h"
+#include "circulation.h"
+#include "core.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// ----------------------------------------------------------------
+// Queue shared with feeder threads; they are detached, so it must
+// outlive the pipeline itself
+// ----------------------------------------------------------------
+namespace {
+struct ScanQueue {
+    mutex              m;
+    condition_variable cv;
+    deque<ScanEvent>   items;
+    uint64_t           nextSeq  = 1;
+    size_t             inFlight = 0;
+    bool               stopping = false;
+    chrono::steady_clock::time_point drainUntil;   // set with stopping
+
+    void push(string barcode) {
+        // Trim whitespace and the CR some scanners append
+        size_t a = barcode.find_first_not_of(" \t\r\n");
+        size_t b = barcode.find_last_not_of(" \t\r\n");
+        if (a == string::npos) return;
+        ScanEvent ev;
+        ev.barcode = barcode.substr(a, b - a + 1);
+        {
+            lock_guard<mutex> g(m);
+            if (stopping) return;
+            ev.seq = nextSeq++;
+            items.push_back(move(ev));
+        }
+        cv.notify_one();
+    }
+};
+}
+
+struct ScanPipeline::Impl {
+    shared_ptr<ScanQueue>   queue = make_shared<ScanQueue>();
+    sqlite3*                conn  = nullptr;
+    unique_ptr<Circulation> circ;     // statements prepared once
+    ScanMode                mode;
+    int                     userID;
+    Callback                onResult;
+    thread                  worker;
+
+    static constexpr size_t maxGroup = 64;
+    // How long the destructor waits on a database another writer keeps
+    // locked; past it the groups still queued fail with Busy
+    static constexpr int drainMs = 2000;
+
+    Impl(const string& path, ScanMode m, int uid, Callback cb)
+        : mode(m), userID(uid), onResult(move(cb)) {
+        if (sqlite3_open(path.c_str(), &conn) != SQLITE_OK) {
+            sqlite3_close(conn);
+            conn = nullptr;
+        } else {
+            enableBusyHandling(conn);
+            addWriterConnection(conn);   // leaves checkpoints to maintenance
+            circ.reset(new Circulation(conn));
+            if (!circ->ok()) circ.reset();
+        }
+        worker = thread([this] { run(); });
+    }
+    ~Impl() {
+        {
+            lock_guard<mutex> g(queue->m);
+            queue->stopping   = true;
+            queue->drainUntil = chrono::steady_clock::now() + chrono::milliseconds(drainMs);
+        }
+        queue->cv.notify_all();
+        worker.join();
+        circ.reset();
+        if (conn) removeWriterConnection(conn);
+        sqlite3_close(conn);
+    }
+
+    void run() {
+        for (;;) {
+            vector<ScanEvent> group;
+            {
+                unique_lock<mutex> g(queue->m);
+                queue->cv.wait(g, [this] { return queue->stopping || !queue->items.empty(); });
+                if (queue->items.empty()) return;   // stopping and drained
+                size_t n = min(queue->items.size(), maxGroup);
+                group.assign(make_move_iterator(queue->items.begin()),
+                             make_move_iterator(queue->items.begin() + n));
+                queue->items.erase(queue->items.begin(), queue->items.begin() + n);
+                queue->inFlight = n;
+            }
+            // Retry the same group until it commits; order is preserved.
+            // Only a pipeline being destroyed gives up, so exit cannot hang.
+            for (int attempt = 0; !applyGroup(group); ++attempt) {
+                if (drainExpired()) {
+                    for (ScanEvent& ev : group) ev.code = ErrorCode::Busy;
+                    break;
+                }
+                this_thread::sleep_for(chrono::milliseconds(min(200, 1 << min(attempt, 8))));
+            }
+            for (const ScanEvent& ev : group) {
+                if (onResult) onResult(ev);
+            }
+            lock_guard<mutex> g(queue->m);
+            queue->inFlight = 0;
+        }
+    }
+
+    bool drainExpired() {
+        lock_guard<mutex> g(queue->m);
+        return queue->stopping && chrono::steady_clock::now() >= queue->drainUntil;
+    }
+
+    // Apply a group in one IMMEDIATE transaction; false means busy, retry
+    bool applyGroup(vector<ScanEvent>& group) {
+        for (ScanEvent& ev : group) ++ev.attempts;
+        if (!circ) {
+            for (ScanEvent& ev : group) ev.code = ErrorCode::Database;
+            return true;
+        }
+        // Read per group, so setLoanLimit reaches a running pipeline
+        circ->setLoanLimit(getLoanLimit());
+        int rc = sqlite3_exec(conn, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK) return fromSqlite(rc) != ErrorCode::Busy && failAll(group, rc);
+
+        for (ScanEvent& ev : group) {
+            sqlite3_exec(conn, "SAVEPOINT scan;", nullptr, nullptr, nullptr);
+            ev.code = applyOne(ev);
+            if (ev.code == ErrorCode::Busy) {
+                sqlite3_exec(conn, "ROLLBACK;", nullptr, nullptr, nullptr);
+                return false;
+            }
+            if (ev.code != ErrorCode::Ok)
+                sqlite3_exec(conn, "ROLLBACK TO scan;", nullptr, nullptr, nullptr);
+            sqlite3_exec(conn, "RELEASE scan;", nullptr, nullptr, nullptr);
+        }
+        rc = sqlite3_exec(conn, "COMMIT;", nullptr, nullptr, nullptr);
+        if (rc == SQLITE_OK) return true;
+        sqlite3_exec(conn, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return fromSqlite(rc) != ErrorCode::Busy && failAll(group, rc);
+    }
+
+    static bool failAll(vector<ScanEvent>& group, int rc) {
+        for (ScanEvent& ev : group) ev.code = fromSqlite(rc);
+        return true;
+    }
+
+    // Item barcode lends/returns that exact copy; ISBN or book ID any copy
+    ErrorCode applyOne(ScanEvent& ev) {
+        Circulation::Target t;
+        ErrorCode code = circ->resolve(ev.barcode, t);
+        if (code != ErrorCode::Ok) return code;
+        ev.bookID = t.bookID;
+        if (mode == ScanMode::Borrow) {
+            return t.itemID ? circ->checkoutItem(userID, t.itemID)
+                            : circ->checkout(userID, t.bookID);
+        }
+        return t.itemID ? circ->checkinItem(t.itemID) : circ->checkin(t.bookID);
+    }
+};
+
+ScanPipeline::ScanPipeline(const string& dbPath, ScanMode mode, int userID, Callback onResult)
+    : impl(new Impl(dbPath, mode, userID, move(onResult))) {}
+
+ScanPipeline::~ScanPipeline() = default;
+
+void ScanPipeline::submit(string barcode) {
+    impl->queue->push(move(barcode));
+}
+
+void ScanPipeline::feedFrom(const string& path) {
+    shared_ptr<ScanQueue> q = impl->queue;
+    thread([q, path] {
+        string line;
+        if (path == "-") {
+            while (getline(cin, line)) q->push(line);
+            return;
+        }
+        ifstream in(path);   // blocks on a FIFO until a writer opens it
+        while (getline(in, line)) q->push(line);
+    }).detach();
+}
+
+size_t ScanPipeline::pending() const {
+    lock_guard<mutex> g(impl->queue->m);
+    return impl->queue->items.size() + impl->queue->inFlight;
+}
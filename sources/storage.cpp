@@ -0,0 +1,1393 @@
+// sources/storage.cpp
+
+#include "storage.h"
+#include "stmt.h"
+#include "flat_map.h"
+#include "isbn.h"
+#include "string_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+// ----------------------------------------------------------------
+// Date helpers (civil <-> day number, proleptic Gregorian)
+// ----------------------------------------------------------------
+static long daysFromCivil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const long era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<long>(doe) - 719468;
+}
+
+static void civilFromDays(long z, int& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    const long era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int>(yoe) + static_cast<int>(era) * 400 + (m <= 2);
+}
+
+int dateToDay(const string& s) {
+    int y = 0; unsigned m = 0, d = 0;
+    if (sscanf(s.c_str(), "%d-%u-%u", &y, &m, &d) != 3) return 0;
+    return static_cast<int>(daysFromCivil(y, m, d));
+}
+
+string dayToDate(int day) {
+    int y = 0; unsigned m = 0, d = 0;
+    civilFromDays(day, y, m, d);
+    char buf[32];
+    snprintf(buf, sizeof buf, "%04d-%02u-%02u", y, m, d);
+    return buf;
+}
+
+static long long systemClock() {
+    return static_cast<long long>(time(nullptr));
+}
+static atomic<Clock> clockNow{systemClock};
+
+void setClock(Clock clock) {
+    clockNow = clock ? clock : systemClock;
+}
+
+int todayDay() {
+    long long secs = clockNow.load()();
+    return static_cast<int>(secs >= 0 ? secs / 86400 : (secs - 86399) / 86400);
+}
+
+string todayDate() {
+    return dayToDate(todayDay());
+}
+
+// ----------------------------------------------------------------
+// v6 migration: move books.author into authors. Each distinct
+// spelling is normalized once and mapped through a temp table, so
+// books is updated in one indexed pass instead of once per author.
+// ----------------------------------------------------------------
+static bool migrateAuthors(sqlite3* handle) {
+    const char* start_sql = R"SQL(
+        BEGIN;
+        CREATE TABLE IF NOT EXISTS authors (
+            id   INTEGER PRIMARY KEY,
+            name TEXT    UNIQUE NOT NULL COLLATE NOCASE
+        );
+        ALTER TABLE books ADD COLUMN author_id INTEGER REFERENCES authors(id);
+        CREATE TEMP TABLE author_map(author TEXT PRIMARY KEY, author_id INTEGER NOT NULL);
+    )SQL";
+    const char* finish_sql = R"SQL(
+        UPDATE books SET author_id=(SELECT author_id FROM temp.author_map m
+                                     WHERE m.author=books.author);
+        DROP TABLE temp.author_map;
+        ALTER TABLE books DROP COLUMN author;
+        CREATE INDEX idx_books_author ON books(author_id);
+        PRAGMA user_version=6;
+        COMMIT;
+    )SQL";
+    bool ok = sqlite3_exec(handle, start_sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (ok) {
+        vector<string> names;
+        Stmt s(handle, "SELECT DISTINCT author FROM books;", nothrow);
+        ok = s.ok();
+        if (ok) s.forEach<string>([&names](string name) { names.push_back(move(name)); });
+
+        Stmt m(handle, "INSERT INTO temp.author_map(author, author_id) VALUES(?,?);", nothrow);
+        ok = ok && m.ok();
+        for (size_t i = 0; ok && i < names.size(); ++i) {
+            int id = internAuthor(handle, names[i]);
+            m.bind(names[i], id);
+            ok = id != 0 && m.done();
+            m.reset();
+        }
+    }
+    ok = ok && sqlite3_exec(handle, finish_sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (!ok) {
+        sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+        sqlite3_exec(handle, "DROP TABLE IF EXISTS temp.author_map;", nullptr, nullptr, nullptr);
+    }
+    return ok;
+}
+
+// ----------------------------------------------------------------
+// Schema shared by library.db and engine snapshots
+// ----------------------------------------------------------------
+void createSchema(sqlite3* handle) {
+    // Only takes effect on a new file; older ones switch over in v7
+    sqlite3_exec(handle, "PRAGMA auto_vacuum=INCREMENTAL;", nullptr, nullptr, nullptr);
+    const char* schema_sql = R"SQL(
+        CREATE TABLE IF NOT EXISTS books (
+            id       INTEGER PRIMARY KEY AUTOINCREMENT,
+            title    TEXT    NOT NULL,
+            author   TEXT    NOT NULL,
+            isbn     TEXT    UNIQUE NOT NULL,
+            year     INTEGER,
+            quantity INTEGER
+        );
+        CREATE TABLE IF NOT EXISTS users (
+            id       INTEGER PRIMARY KEY AUTOINCREMENT,
+            name     TEXT    NOT NULL,
+            role     TEXT    CHECK(role IN ('admin','student')) NOT NULL,
+            username TEXT    UNIQUE NOT NULL,
+            password TEXT    NOT NULL
+        );
+        CREATE TABLE IF NOT EXISTS loans (
+            id          INTEGER PRIMARY KEY AUTOINCREMENT,
+            user_id     INTEGER NOT NULL,
+            book_id     INTEGER NOT NULL,
+            borrow_date INTEGER NOT NULL,
+            return_date INTEGER,
+            FOREIGN KEY(user_id) REFERENCES users(id),
+            FOREIGN KEY(book_id) REFERENCES books(id)
+        );
+        CREATE INDEX IF NOT EXISTS idx_loans_open_book
+            ON loans(book_id, borrow_date) WHERE return_date IS NULL;
+    )SQL";
+    sqlite3_exec(handle, schema_sql, nullptr, nullptr, nullptr);
+
+    int version = 0;
+    {
+        Stmt v(handle, "PRAGMA user_version;", nothrow);
+        if (v.ok() && v.step() == SQLITE_ROW) version = get<0>(v.row<int>());
+    }
+
+    // v1: one row per physical copy; quantity = available items
+    if (version < 1) {
+        const char* items_sql = R"SQL(
+            BEGIN;
+            ALTER TABLE loans ADD COLUMN item_id INTEGER REFERENCES items(id);
+            CREATE TABLE IF NOT EXISTS items (
+                id      INTEGER PRIMARY KEY AUTOINCREMENT,
+                book_id INTEGER NOT NULL,
+                barcode TEXT    UNIQUE NOT NULL,
+                status  TEXT    CHECK(status IN ('available','on_loan','lost','withdrawn'))
+                                NOT NULL DEFAULT 'available',
+                FOREIGN KEY(book_id) REFERENCES books(id)
+            );
+            CREATE INDEX IF NOT EXISTS idx_items_availability ON items(book_id, status);
+            CREATE INDEX IF NOT EXISTS idx_loans_open_item
+                ON loans(item_id) WHERE return_date IS NULL;
+
+            CREATE TRIGGER IF NOT EXISTS items_qty_insert AFTER INSERT ON items
+            WHEN NEW.status='available' BEGIN
+                UPDATE books SET quantity=quantity+1 WHERE id=NEW.book_id;
+            END;
+            CREATE TRIGGER IF NOT EXISTS items_qty_delete AFTER DELETE ON items
+            WHEN OLD.status='available' BEGIN
+                UPDATE books SET quantity=quantity-1 WHERE id=OLD.book_id;
+            END;
+            CREATE TRIGGER IF NOT EXISTS items_qty_update AFTER UPDATE OF status, book_id ON items
+            WHEN (OLD.status='available') != (NEW.status='available') OR OLD.book_id != NEW.book_id BEGIN
+                UPDATE books SET quantity=quantity-(OLD.status='available') WHERE id=OLD.book_id;
+                UPDATE books SET quantity=quantity+(NEW.status='available') WHERE id=NEW.book_id;
+            END;
+            PRAGMA user_version=1;
+            COMMIT;
+        )SQL";
+        if (sqlite3_exec(handle, items_sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+            sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+
+    // v2: holds queue; the partial index is the per-title priority queue
+    if (version < 2) {
+        const char* holds_sql = R"SQL(
+            BEGIN;
+            CREATE TABLE IF NOT EXISTS holds (
+                id        INTEGER PRIMARY KEY AUTOINCREMENT,
+                user_id   INTEGER NOT NULL,
+                book_id   INTEGER NOT NULL,
+                priority  INTEGER NOT NULL DEFAULT 0,
+                placed_at TEXT    NOT NULL,
+                status    TEXT    CHECK(status IN ('waiting','fulfilled','cancelled'))
+                                  NOT NULL DEFAULT 'waiting',
+                loan_id   INTEGER,
+                FOREIGN KEY(user_id) REFERENCES users(id),
+                FOREIGN KEY(book_id) REFERENCES books(id),
+                FOREIGN KEY(loan_id) REFERENCES loans(id)
+            );
+            CREATE INDEX IF NOT EXISTS idx_holds_queue
+                ON holds(book_id, priority DESC, id) WHERE status='waiting';
+            CREATE UNIQUE INDEX IF NOT EXISTS ux_holds_waiting
+                ON holds(user_id, book_id) WHERE status='waiting';
+            PRAGMA user_version=2;
+            COMMIT;
+        )SQL";
+        if (sqlite3_exec(handle, holds_sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+            sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+
+    // v3: per-patron circulation summary kept current by loan triggers.
+    // overdue counts open loans already past due on swept_on, so a
+    // return only subtracts loans the last sweep actually counted.
+    if (version < 3) {
+        const char* summary_sql = R"SQL(
+            BEGIN;
+            CREATE TABLE IF NOT EXISTS user_circ (
+                user_id        INTEGER PRIMARY KEY,
+                open_loans     INTEGER NOT NULL DEFAULT 0,
+                overdue        INTEGER NOT NULL DEFAULT 0,
+                lifetime_loans INTEGER NOT NULL DEFAULT 0,
+                last_activity  TEXT,
+                swept_on       TEXT    NOT NULL DEFAULT (DATE('now'))
+            );
+            INSERT OR REPLACE INTO user_circ(user_id, open_loans, lifetime_loans, last_activity, swept_on)
+                SELECT user_id, SUM(return_date IS NULL), COUNT(*),
+                       MAX(MAX(borrow_date), IFNULL(MAX(return_date), '')), '0000-00-00'
+                  FROM loans GROUP BY user_id;
+
+            CREATE TRIGGER IF NOT EXISTS user_circ_open AFTER INSERT ON loans BEGIN
+                INSERT OR IGNORE INTO user_circ(user_id) VALUES(NEW.user_id);
+                UPDATE user_circ SET open_loans     = open_loans + (NEW.return_date IS NULL),
+                                     lifetime_loans = lifetime_loans + 1,
+                                     last_activity  = MAX(IFNULL(last_activity, ''), NEW.borrow_date)
+                 WHERE user_id=NEW.user_id;
+            END;
+            CREATE TRIGGER IF NOT EXISTS user_circ_close AFTER UPDATE OF return_date ON loans
+            WHEN OLD.return_date IS NULL AND NEW.return_date IS NOT NULL BEGIN
+                UPDATE user_circ SET open_loans    = open_loans - 1,
+                                     overdue       = overdue - (DATE(OLD.borrow_date, '+14 days') < swept_on),
+                                     last_activity = MAX(IFNULL(last_activity, ''), NEW.return_date)
+                 WHERE user_id=OLD.user_id;
+            END;
+            -- Deleting a loan (archival) keeps it in lifetime_loans
+            CREATE TRIGGER IF NOT EXISTS user_circ_delete AFTER DELETE ON loans
+            WHEN OLD.return_date IS NULL BEGIN
+                UPDATE user_circ SET open_loans = open_loans - 1,
+                                     overdue    = overdue - (DATE(OLD.borrow_date, '+14 days') < swept_on)
+                 WHERE user_id=OLD.user_id;
+            END;
+            PRAGMA user_version=3;
+            COMMIT;
+        )SQL";
+        if (sqlite3_exec(handle, summary_sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+            sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+
+    // v4: loan dates become day numbers. loans and user_circ are
+    // rebuilt because their TEXT affinity would turn integers back into
+    // strings; the triggers and indexes on loans are recreated with them.
+    if (version < 4) {
+        const char* days_sql = R"SQL(
+            BEGIN;
+            CREATE TABLE loans_v4 (
+                id          INTEGER PRIMARY KEY AUTOINCREMENT,
+                user_id     INTEGER NOT NULL,
+                book_id     INTEGER NOT NULL,
+                borrow_date INTEGER NOT NULL,
+                return_date INTEGER,
+                item_id     INTEGER REFERENCES items(id),
+                FOREIGN KEY(user_id) REFERENCES users(id),
+                FOREIGN KEY(book_id) REFERENCES books(id)
+            );
+            INSERT INTO loans_v4(id, user_id, book_id, borrow_date, return_date, item_id)
+                SELECT id, user_id, book_id,
+                       CASE typeof(borrow_date) WHEN 'text'
+                            THEN CAST(julianday(borrow_date) - 2440587.5 AS INTEGER)
+                            ELSE borrow_date END,
+                       CASE typeof(return_date) WHEN 'text'
+                            THEN CAST(julianday(return_date) - 2440587.5 AS INTEGER)
+                            ELSE return_date END,
+                       item_id
+                  FROM loans;
+            DROP TABLE loans;
+            ALTER TABLE loans_v4 RENAME TO loans;
+            CREATE INDEX idx_loans_open_book
+                ON loans(book_id, borrow_date) WHERE return_date IS NULL;
+            CREATE INDEX idx_loans_open_item
+                ON loans(item_id) WHERE return_date IS NULL;
+
+            DROP TABLE user_circ;
+            CREATE TABLE user_circ (
+                user_id        INTEGER PRIMARY KEY,
+                open_loans     INTEGER NOT NULL DEFAULT 0,
+                overdue        INTEGER NOT NULL DEFAULT 0,
+                lifetime_loans INTEGER NOT NULL DEFAULT 0,
+                last_activity  INTEGER NOT NULL DEFAULT 0,
+                swept_on       INTEGER NOT NULL DEFAULT 0
+            );
+            INSERT INTO user_circ(user_id, open_loans, lifetime_loans, last_activity)
+                SELECT user_id, SUM(return_date IS NULL), COUNT(*),
+                       MAX(MAX(borrow_date), IFNULL(MAX(return_date), 0))
+                  FROM loans GROUP BY user_id;
+
+            CREATE TRIGGER user_circ_open AFTER INSERT ON loans BEGIN
+                INSERT OR IGNORE INTO user_circ(user_id) VALUES(NEW.user_id);
+                UPDATE user_circ SET open_loans     = open_loans + (NEW.return_date IS NULL),
+                                     lifetime_loans = lifetime_loans + 1,
+                                     last_activity  = MAX(last_activity, NEW.borrow_date)
+                 WHERE user_id=NEW.user_id;
+            END;
+            CREATE TRIGGER user_circ_close AFTER UPDATE OF return_date ON loans
+            WHEN OLD.return_date IS NULL AND NEW.return_date IS NOT NULL BEGIN
+                UPDATE user_circ SET open_loans    = open_loans - 1,
+                                     overdue       = overdue - (OLD.borrow_date + 14 < swept_on),
+                                     last_activity = MAX(last_activity, NEW.return_date)
+                 WHERE user_id=OLD.user_id;
+            END;
+            CREATE TRIGGER user_circ_delete AFTER DELETE ON loans
+            WHEN OLD.return_date IS NULL BEGIN
+                UPDATE user_circ SET open_loans = open_loans - 1,
+                                     overdue    = overdue - (OLD.borrow_date + 14 < swept_on)
+                 WHERE user_id=OLD.user_id;
+            END;
+            PRAGMA user_version=4;
+            COMMIT;
+        )SQL";
+        if (sqlite3_exec(handle, days_sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+            sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+
+    // v5: ISBN-13 as a 64-bit key with its own unique index
+    if (version < 5) {
+        const char* isbn_sql = R"SQL(
+            BEGIN;
+            ALTER TABLE books ADD COLUMN isbn13 INTEGER;
+            CREATE UNIQUE INDEX IF NOT EXISTS idx_books_isbn13 ON books(isbn13);
+            PRAGMA user_version=5;
+            COMMIT;
+        )SQL";
+        if (sqlite3_exec(handle, isbn_sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+            sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+
+    // v6: author names move to their own table (see migrateAuthors);
+    // VACUUM returns the pages the dropped column leaves free
+    if (version < 6 && migrateAuthors(handle))
+        sqlite3_exec(handle, "VACUUM;", nullptr, nullptr, nullptr);
+
+    // v7: incremental auto-vacuum, so free pages can be handed back a
+    // few at a time by the maintenance thread. The mode is stored in the
+    // file header and changes only on VACUUM, which v6 may have just run.
+    auto autoVacuum = [handle] {
+        Stmt a(handle, "PRAGMA auto_vacuum;", nothrow);
+        return a.ok() && a.step() == SQLITE_ROW ? get<0>(a.row<int>()) : -1;
+    };
+    if (version < 7) {
+        if (autoVacuum() != 2) sqlite3_exec(handle, "VACUUM;", nullptr, nullptr, nullptr);
+        if (autoVacuum() == 2) sqlite3_exec(handle, "PRAGMA user_version=7;", nullptr, nullptr, nullptr);
+    }
+
+    // v8: branch registry. Branch 1 is this file and has no row; the
+    // table stays empty in branch files and snapshots. The version is
+    // held back while v7 is still pending, so its VACUUM is retried.
+    if (version < 8) {
+        const char* v8_sql = R"SQL(
+            CREATE TABLE IF NOT EXISTS branches (
+                id   INTEGER PRIMARY KEY CHECK (id > 1),
+                name TEXT NOT NULL UNIQUE COLLATE NOCASE,
+                path TEXT NOT NULL
+            );
+        )SQL";
+        if (sqlite3_exec(handle, v8_sql, nullptr, nullptr, nullptr) == SQLITE_OK && autoVacuum() == 2)
+            sqlite3_exec(handle, "PRAGMA user_version=8;", nullptr, nullptr, nullptr);
+    }
+
+    // v9: copies moving between branch files. The sending file keeps
+    // one transfers row per copy until the receiving file has it; the
+    // receiver notes each arrival once, so a transfer cut short is
+    // simply delivered again. Locations only matter in library.db.
+    if (version < 9) {
+        const char* v9_sql = R"SQL(
+            CREATE TABLE IF NOT EXISTS transfers (
+                id        INTEGER PRIMARY KEY AUTOINCREMENT,
+                to_branch INTEGER NOT NULL,
+                isbn13    INTEGER NOT NULL,
+                barcode   TEXT    NOT NULL,
+                sent      INTEGER NOT NULL,
+                received  INTEGER
+            );
+            CREATE INDEX IF NOT EXISTS idx_transfers_transit
+                ON transfers(to_branch) WHERE received IS NULL;
+            CREATE TABLE IF NOT EXISTS arrivals (
+                from_branch INTEGER NOT NULL,
+                transfer_id INTEGER NOT NULL,
+                PRIMARY KEY (from_branch, transfer_id)
+            ) WITHOUT ROWID;
+            CREATE TABLE IF NOT EXISTS branch_locations (
+                branch_id INTEGER PRIMARY KEY,
+                lat       REAL NOT NULL,
+                lon       REAL NOT NULL
+            );
+        )SQL";
+        if (sqlite3_exec(handle, v9_sql, nullptr, nullptr, nullptr) == SQLITE_OK && autoVacuum() == 2)
+            sqlite3_exec(handle, "PRAGMA user_version=9;", nullptr, nullptr, nullptr);
+    }
+
+    // v10: "also borrowed" lists written by the offline build, best
+    // first per book, and one row per finished build so running
+    // instances can tell a new one has landed
+    if (version < 10) {
+        const char* v10_sql = R"SQL(
+            CREATE TABLE IF NOT EXISTS also_borrowed (
+                book_id  INTEGER NOT NULL,
+                rank     INTEGER NOT NULL,
+                other_id INTEGER NOT NULL,
+                patrons  INTEGER NOT NULL,
+                PRIMARY KEY (book_id, rank)
+            ) WITHOUT ROWID;
+            CREATE TABLE IF NOT EXISTS recommendation_builds (
+                id      INTEGER PRIMARY KEY AUTOINCREMENT,
+                built   INTEGER NOT NULL,
+                patrons INTEGER NOT NULL,
+                books   INTEGER NOT NULL,
+                pairs   INTEGER NOT NULL
+            );
+        )SQL";
+        if (sqlite3_exec(handle, v10_sql, nullptr, nullptr, nullptr) == SQLITE_OK && autoVacuum() == 2)
+            sqlite3_exec(handle, "PRAGMA user_version=10;", nullptr, nullptr, nullptr);
+    }
+
+    // v11: holds.placed_at becomes a day number like the loan dates
+    // in v4; the table is rebuilt for the same reason. Rerunning it
+    // while the version is held back leaves day numbers as they are.
+    if (version < 11) {
+        const char* v11_sql = R"SQL(
+            BEGIN;
+            CREATE TABLE holds_v11 (
+                id        INTEGER PRIMARY KEY AUTOINCREMENT,
+                user_id   INTEGER NOT NULL,
+                book_id   INTEGER NOT NULL,
+                priority  INTEGER NOT NULL DEFAULT 0,
+                placed_at INTEGER NOT NULL,
+                status    TEXT    CHECK(status IN ('waiting','fulfilled','cancelled'))
+                                  NOT NULL DEFAULT 'waiting',
+                loan_id   INTEGER,
+                FOREIGN KEY(user_id) REFERENCES users(id),
+                FOREIGN KEY(book_id) REFERENCES books(id),
+                FOREIGN KEY(loan_id) REFERENCES loans(id)
+            );
+            INSERT INTO holds_v11(id, user_id, book_id, priority, placed_at, status, loan_id)
+                SELECT id, user_id, book_id, priority,
+                       CASE typeof(placed_at) WHEN 'text'
+                            THEN CAST(julianday(placed_at) - 2440587.5 AS INTEGER)
+                            ELSE placed_at END,
+                       status, loan_id
+                  FROM holds;
+            DROP TABLE holds;
+            ALTER TABLE holds_v11 RENAME TO holds;
+            CREATE INDEX idx_holds_queue
+                ON holds(book_id, priority DESC, id) WHERE status='waiting';
+            CREATE UNIQUE INDEX ux_holds_waiting
+                ON holds(user_id, book_id) WHERE status='waiting';
+            COMMIT;
+        )SQL";
+        if (sqlite3_exec(handle, v11_sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+            sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+        else if (autoVacuum() == 2)
+            sqlite3_exec(handle, "PRAGMA user_version=11;", nullptr, nullptr, nullptr);
+    }
+
+    syncItems(handle);
+    syncIsbn(handle);
+    sweepOverdue(handle);
+}
+
+// ----------------------------------------------------------------
+// Attach the loan archive as schema "archive", creating it if needed.
+// Closed loans moved there keep their ids, so history can UNION ALL
+// both tables without duplicates. The archive has its own
+// user_version; v1 stores day numbers like main.loans.
+// ----------------------------------------------------------------
+bool attachArchive(sqlite3* handle, const string& path) {
+    Stmt attach(handle, "ATTACH DATABASE ? AS archive;", nothrow);
+    if (!attach.ok()) return false;
+    attach.bind(path);
+    if (!attach.done()) return false;
+
+    int version = 0;
+    {
+        Stmt v(handle, "PRAGMA archive.user_version;", nothrow);
+        if (v.ok() && v.step() == SQLITE_ROW) version = get<0>(v.row<int>());
+    }
+    if (version >= 1) return true;
+
+    // A new file gets the old layout first so one rebuild path covers both
+    const char* archive_sql = R"SQL(
+        BEGIN;
+        CREATE TABLE IF NOT EXISTS archive.loans (
+            id          INTEGER PRIMARY KEY,
+            user_id     INTEGER NOT NULL,
+            book_id     INTEGER NOT NULL,
+            item_id     INTEGER,
+            borrow_date TEXT    NOT NULL,
+            return_date TEXT    NOT NULL
+        );
+        CREATE TABLE archive.loans_v1 (
+            id          INTEGER PRIMARY KEY,
+            user_id     INTEGER NOT NULL,
+            book_id     INTEGER NOT NULL,
+            item_id     INTEGER,
+            borrow_date INTEGER NOT NULL,
+            return_date INTEGER NOT NULL
+        );
+        INSERT INTO archive.loans_v1
+            SELECT id, user_id, book_id, item_id,
+                   CAST(julianday(borrow_date) - 2440587.5 AS INTEGER),
+                   CAST(julianday(return_date) - 2440587.5 AS INTEGER)
+              FROM archive.loans;
+        DROP TABLE archive.loans;
+        ALTER TABLE archive.loans_v1 RENAME TO loans;
+        CREATE INDEX archive.idx_archive_loans_user ON loans(user_id);
+        PRAGMA archive.user_version=1;
+        COMMIT;
+    )SQL";
+    if (sqlite3_exec(handle, archive_sql, nullptr, nullptr, nullptr) == SQLITE_OK) return true;
+    sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+    return false;
+}
+
+// ----------------------------------------------------------------
+// Due-date sweep: recount overdue loans for summaries not yet swept
+// today. One pass over open loans; a no-op on a second run that day.
+// ----------------------------------------------------------------
+bool sweepOverdue(sqlite3* handle) {
+    Stmt sweep(handle, R"SQL(
+        WITH due(user_id, n) AS (
+            SELECT user_id, COUNT(*) FROM loans
+             WHERE return_date IS NULL AND borrow_date + 14 < ?1
+             GROUP BY user_id
+        )
+        UPDATE user_circ
+           SET overdue  = IFNULL((SELECT n FROM due WHERE due.user_id=user_circ.user_id), 0),
+               swept_on = ?1
+         WHERE swept_on < ?1;
+    )SQL", nothrow);
+    if (!sweep.ok()) return false;
+    sweep.bind(todayDay());
+    return sweep.done();
+}
+
+// ----------------------------------------------------------------
+// Paced copy through the backup API (backups, report replicas)
+// ----------------------------------------------------------------
+int copyDatabase(sqlite3* from, sqlite3* to, int pagesPerStep, int pauseMs, int* pages, int* steps) {
+    // Pin the snapshot unless the caller already holds a transaction
+    bool pinned = false;
+    if (sqlite3_get_autocommit(from)) {
+        int rc = sqlite3_exec(from, "BEGIN; SELECT 1 FROM sqlite_schema LIMIT 1;", nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK) {
+            sqlite3_exec(from, "ROLLBACK;", nullptr, nullptr, nullptr);
+            return rc;
+        }
+        pinned = true;
+    }
+    int n = 0;
+    int rc = SQLITE_OK;
+    sqlite3_backup* bk = sqlite3_backup_init(to, "main", from, "main");
+    if (!bk) {
+        rc = sqlite3_errcode(to);
+    } else {
+        while ((rc = sqlite3_backup_step(bk, pagesPerStep > 0 ? pagesPerStep : -1)) != SQLITE_DONE) {
+            if (rc != SQLITE_OK && rc != SQLITE_BUSY && rc != SQLITE_LOCKED) break;
+            ++n;
+            if (pauseMs > 0) this_thread::sleep_for(chrono::milliseconds(pauseMs));
+        }
+        if (rc == SQLITE_DONE) ++n;
+        if (pages) *pages = sqlite3_backup_pagecount(bk);
+        int fin = sqlite3_backup_finish(bk);
+        rc = rc == SQLITE_DONE ? fin : rc;
+    }
+    if (pinned) sqlite3_exec(from, "COMMIT;", nullptr, nullptr, nullptr);
+    if (steps) *steps = n;
+    return rc;
+}
+
+// ----------------------------------------------------------------
+// Fill books.isbn13 where it is missing (rows from before v5, engine
+// snapshots). Invalid ISBNs stay NULL; a second spelling of an ISBN
+// already keyed is skipped by OR IGNORE and also stays NULL.
+// ----------------------------------------------------------------
+void syncIsbn(sqlite3* handle) {
+    vector<int> ids;
+    vector<string> text;
+    {
+        Stmt s(handle, "SELECT id, isbn FROM books WHERE isbn13 IS NULL;", nothrow);
+        if (!s.ok()) return;
+        s.forEach<int, string>([&](int id, string isbn) {
+            ids.push_back(id);
+            text.push_back(move(isbn));
+        });
+    }
+    vector<int64_t> keys;
+    normalizeIsbns(text, keys);
+
+    Stmt u(handle, "UPDATE OR IGNORE books SET isbn13=? WHERE id=?;", nothrow);
+    if (!u.ok()) return;
+    sqlite3_exec(handle, "BEGIN;", nullptr, nullptr, nullptr);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (!keys[i]) continue;
+        u.bind(static_cast<long long>(keys[i]), ids[i]);
+        u.step();
+        u.reset();
+    }
+    sqlite3_exec(handle, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+// ----------------------------------------------------------------
+// Give copies to books that only have a bare quantity (databases
+// from before v1, or restored engine snapshots). Idempotent.
+// ----------------------------------------------------------------
+void syncItems(sqlite3* handle) {
+    const char* sync_sql = R"SQL(
+        BEGIN;
+        CREATE TEMP TABLE item_fill AS
+            SELECT id, quantity FROM books b
+             WHERE quantity > 0 AND NOT EXISTS (SELECT 1 FROM items i WHERE i.book_id=b.id);
+        -- Triggers add the quantity back as the available copies are inserted
+        UPDATE books SET quantity=0 WHERE id IN (SELECT id FROM item_fill);
+        WITH RECURSIVE n(book_id, k, total) AS (
+            SELECT id, 1, quantity FROM item_fill
+            UNION ALL
+            SELECT book_id, k + 1, total FROM n WHERE k < total
+        )
+        INSERT INTO items(book_id, barcode, status)
+            SELECT book_id, printf('%d-%d', book_id, k), 'available' FROM n;
+        DROP TABLE item_fill;
+
+        -- Open loans without a copy get an on-loan copy of their own
+        INSERT INTO items(book_id, barcode, status)
+            SELECT book_id, printf('%d-L%d', book_id, id), 'on_loan' FROM loans
+             WHERE return_date IS NULL AND item_id IS NULL;
+        UPDATE loans SET item_id=(SELECT i.id FROM items i
+                                   WHERE i.barcode=printf('%d-L%d', loans.book_id, loans.id))
+         WHERE return_date IS NULL AND item_id IS NULL;
+        COMMIT;
+    )SQL";
+    if (sqlite3_exec(handle, sync_sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+        sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+}
+
+// ----------------------------------------------------------------
+// Register count new copies of a book with generated barcodes. They
+// are numbered after the highest "<book>-<k>" barcode in use, so a
+// copy added by hand under that scheme is never collided with.
+// ----------------------------------------------------------------
+bool addCopies(sqlite3* handle, int bookID, int count) {
+    if (count <= 0) return true;
+    Stmt s(handle, R"SQL(
+        WITH RECURSIVE n(k, last) AS (
+            SELECT c + 1, c + ?2 FROM (
+                SELECT COALESCE(MAX(CAST(substr(barcode, length(?3) + 1) AS INTEGER)), 0) AS c
+                  FROM items WHERE barcode GLOB ?3 || '[0-9]*')
+            UNION ALL
+            SELECT k + 1, last FROM n WHERE k < last
+        )
+        INSERT INTO items(book_id, barcode) SELECT ?1, printf('%d-%d', ?1, k) FROM n;
+    )SQL", nothrow);
+    if (!s.ok()) return false;
+    s.bind(bookID, count, to_string(bookID) + "-");
+    return s.done();
+}
+
+// ----------------------------------------------------------------
+// Author interning: one authors row per name, matched ignoring ASCII
+// case (the column is COLLATE NOCASE); the first spelling is kept
+// ----------------------------------------------------------------
+string normalizeAuthor(const string& name) {
+    string out;
+    out.reserve(name.size());
+    for (char c : name) {
+        if (isspace(static_cast<unsigned char>(c))) {
+            if (!out.empty() && out.back() != ' ') out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    if (!out.empty() && out.back() == ' ') out.pop_back();
+    return out;
+}
+
+int internAuthor(sqlite3* handle, const string& name) {
+    string norm = normalizeAuthor(name);
+    Stmt find(handle, "SELECT id FROM authors WHERE name=?;", nothrow);
+    if (!find.ok()) return 0;
+    find.bind(norm);
+    if (find.step() == SQLITE_ROW) return get<0>(find.row<int>());
+    Stmt add(handle, "INSERT INTO authors(name) VALUES(?);", nothrow);
+    if (!add.ok()) return 0;
+    add.bind(norm);
+    if (!add.done()) return 0;
+    return static_cast<int>(sqlite3_last_insert_rowid(handle));
+}
+
+// ================================================================
+// SQLite engine
+// ================================================================
+namespace {
+
+class SqliteBooks : public BookRepository {
+public:
+    explicit SqliteBooks(sqlite3* h) : db(h) {}
+
+    // Like insertBook: only a valid ISBN, stored as its ISBN-13 text
+    int add(const Book& b) override {
+        long long key = normalizeIsbn(b.isbn);
+        if (!key) return -1;
+        sqlite3_exec(db, "SAVEPOINT add_book;", nullptr, nullptr, nullptr);
+        int authorID = internAuthor(db, b.author);
+        Stmt s(db, "INSERT INTO books(title,author_id,isbn,year,quantity,isbn13) VALUES(?,?,?,?,0,?);");
+        s.bind(b.title, authorID, isbnText(key), b.year, key);
+        int id = authorID && s.done() ? static_cast<int>(sqlite3_last_insert_rowid(db)) : -1;
+        if (id < 0 || !addCopies(db, id, b.quantity)) {
+            sqlite3_exec(db, "ROLLBACK TO add_book; RELEASE add_book;", nullptr, nullptr, nullptr);
+            return -1;
+        }
+        sqlite3_exec(db, "RELEASE add_book;", nullptr, nullptr, nullptr);
+        return id;
+    }
+    // Quantity is derived from items; use adjustQuantity to change it
+    bool update(const Book& b) override {
+        long long key = normalizeIsbn(b.isbn);
+        if (!key) return false;
+        int authorID = internAuthor(db, b.author);
+        if (!authorID) return false;
+        Stmt s(db, "UPDATE books SET title=?,author_id=?,isbn=?,isbn13=?,year=? WHERE id=?;");
+        s.bind(b.title, authorID, isbnText(key), key, b.year, b.id);
+        return s.done() && sqlite3_changes(db) == 1;
+    }
+    // Refused while a copy is on loan (its return needs the item row)
+    // or in transit (delivery reads the title from this file)
+    bool remove(int bookID) override {
+        Stmt busy(db, R"SQL(
+            SELECT 1 FROM loans WHERE book_id=?1 AND return_date IS NULL
+            UNION ALL
+            SELECT 1 FROM transfers t JOIN books b ON b.isbn13=t.isbn13
+             WHERE b.id=?1 AND t.received IS NULL
+            LIMIT 1;
+        )SQL");
+        busy.bind(bookID);
+        if (busy.step() != SQLITE_DONE) return false;
+        Stmt items(db, "DELETE FROM items WHERE book_id=?;");
+        items.bind(bookID);
+        if (!items.done()) return false;
+        Stmt s(db, "DELETE FROM books WHERE id=?;");
+        s.bind(bookID);
+        return s.done() && sqlite3_changes(db) == 1;
+    }
+    bool findByID(int bookID, Book& out) override {
+        Stmt s(db, "SELECT b.id,b.title,a.name,b.isbn,b.year,b.quantity FROM books b "
+                   "JOIN authors a ON a.id=b.author_id WHERE b.id=?;");
+        s.bind(bookID);
+        if (s.step() != SQLITE_ROW) return false;
+        out = read(s);
+        return true;
+    }
+    vector<Book> list() override {
+        Stmt s(db, "SELECT b.id,b.title,a.name,b.isbn,b.year,b.quantity FROM books b "
+                   "JOIN authors a ON a.id=b.author_id;");
+        vector<Book> out;
+        while (s.step() == SQLITE_ROW) out.push_back(read(s));
+        return out;
+    }
+    // Scans books in id order, so a limit stops the scan early
+    vector<Book> search(const string& keyword, size_t limit) override {
+        Stmt s(db, "SELECT b.id,b.title,a.name,b.isbn,b.year,b.quantity FROM books b "
+                   "JOIN authors a ON a.id=b.author_id "
+                   "WHERE b.title LIKE ?1 OR a.name LIKE ?1 ORDER BY b.id LIMIT ?2;");
+        s.bind("%" + keyword + "%", limit ? static_cast<long long>(limit) : -1LL);
+        vector<Book> out;
+        while (s.step() == SQLITE_ROW) out.push_back(read(s));
+        return out;
+    }
+    // authors.name is unique, then idx_books_author finds the titles
+    vector<Book> byAuthor(const string& author) override {
+        Stmt s(db, "SELECT b.id,b.title,a.name,b.isbn,b.year,b.quantity FROM books b "
+                   "JOIN authors a ON a.id=b.author_id "
+                   "WHERE a.name=? ORDER BY b.id;");
+        s.bind(normalizeAuthor(author));
+        vector<Book> out;
+        while (s.step() == SQLITE_ROW) out.push_back(read(s));
+        return out;
+    }
+    // Take copies off the shelf (delta < 0) or put them back/add new ones
+    bool adjustQuantity(int bookID, int delta) override {
+        if (delta < 0) {
+            Stmt s(db, R"SQL(
+                UPDATE items SET status='on_loan'
+                 WHERE id IN (SELECT id FROM items WHERE book_id=?1 AND status='available'
+                               LIMIT ?2)
+                   AND (SELECT COUNT(*) FROM items WHERE book_id=?1 AND status='available') >= ?2;
+            )SQL");
+            s.bind(bookID, -delta);
+            return s.done() && sqlite3_changes(db) == -delta;
+        }
+        Stmt s(db, R"SQL(
+            UPDATE items SET status='available'
+             WHERE id IN (SELECT i.id FROM items i
+                           WHERE i.book_id=?1 AND i.status='on_loan'
+                             AND NOT EXISTS (SELECT 1 FROM loans l
+                                              WHERE l.item_id=i.id AND l.return_date IS NULL)
+                           LIMIT ?2);
+        )SQL");
+        s.bind(bookID, delta);
+        if (!s.done()) return false;
+        return addCopies(db, bookID, delta - sqlite3_changes(db));
+    }
+
+private:
+    sqlite3* db;
+    static Book read(const Stmt& s) {
+        Book b;
+        s.into(b.id, b.title, b.author, b.isbn, b.year, b.quantity);
+        return b;
+    }
+};
+
+class SqliteLoans : public LoanRepository {
+public:
+    explicit SqliteLoans(sqlite3* h) : db(h) {}
+
+    int open(int userID, int bookID, int day) override {
+        Stmt s(db, "INSERT INTO loans(user_id,book_id,borrow_date) VALUES(?,?,?);");
+        s.bind(userID, bookID, day);
+        if (!s.done()) return -1;
+        return static_cast<int>(sqlite3_last_insert_rowid(db));
+    }
+    bool close(int userID, int bookID, int day) override {
+        Stmt s(db, R"SQL(
+            UPDATE loans SET return_date=?3
+             WHERE id=(SELECT id FROM loans
+                        WHERE user_id=?1 AND book_id=?2 AND return_date IS NULL
+                        ORDER BY borrow_date DESC, id DESC LIMIT 1);
+        )SQL");
+        s.bind(userID, bookID, day);
+        return s.done() && sqlite3_changes(db) == 1;
+    }
+    vector<Loan> byUser(int userID) override {
+        Stmt s(db, "SELECT id,user_id,book_id,borrow_date,return_date FROM loans WHERE user_id=?;");
+        s.bind(userID);
+        vector<Loan> out;
+        while (s.step() == SQLITE_ROW) {
+            Loan l;
+            s.into(l.id, l.userID, l.bookID, l.borrowDay, l.returnDay);
+            out.push_back(l);
+        }
+        return out;
+    }
+    int countOverdue(int userID, int today, int loanDays) override {
+        Stmt s(db, R"SQL(
+            SELECT COUNT(*) FROM loans
+             WHERE user_id=? AND return_date IS NULL AND borrow_date + ? < ?;
+        )SQL");
+        s.bind(userID, loanDays, today);
+        return s.step() == SQLITE_ROW ? get<0>(s.row<int>()) : 0;
+    }
+
+private:
+    sqlite3* db;
+};
+
+class SqliteUsers : public UserRepository {
+public:
+    explicit SqliteUsers(sqlite3* h) : db(h) {}
+
+    int add(const User& u) override {
+        Stmt s(db, "INSERT INTO users(name,role,username,password) VALUES(?,?,?,?);");
+        s.bind(u.name, u.role, u.username, u.password);
+        if (!s.done()) return -1;
+        return static_cast<int>(sqlite3_last_insert_rowid(db));
+    }
+    bool findByID(int userID, User& out) override {
+        Stmt s(db, "SELECT id,name,role,username,password FROM users WHERE id=?;");
+        s.bind(userID);
+        return fetch(s, out);
+    }
+    bool findByUsername(const string& username, User& out) override {
+        Stmt s(db, "SELECT id,name,role,username,password FROM users WHERE username=?;");
+        s.bind(username);
+        return fetch(s, out);
+    }
+
+private:
+    sqlite3* db;
+    static bool fetch(Stmt& s, User& out) {
+        if (s.step() != SQLITE_ROW) return false;
+        s.into(out.id, out.name, out.role, out.username, out.password);
+        return true;
+    }
+};
+
+class SqliteStorage : public StorageEngine {
+public:
+    explicit SqliteStorage(sqlite3* h) : db(h), bookRepo(h), loanRepo(h), userRepo(h) {}
+
+    const char*     name() const override { return "sqlite"; }
+    BookRepository& books() override { return bookRepo; }
+    LoanRepository& loans() override { return loanRepo; }
+    UserRepository& users() override { return userRepo; }
+
+    bool snapshot(const string& path) override {
+        sqlite3* dest = nullptr;
+        if (sqlite3_open(path.c_str(), &dest) != SQLITE_OK) {
+            sqlite3_close(dest);
+            return false;
+        }
+        sqlite3_backup* bk = sqlite3_backup_init(dest, "main", db, "main");
+        bool ok = bk && sqlite3_backup_step(bk, -1) == SQLITE_DONE;
+        if (bk) sqlite3_backup_finish(bk);
+        sqlite3_close(dest);
+        return ok;
+    }
+
+private:
+    sqlite3*    db;
+    SqliteBooks bookRepo;
+    SqliteLoans loanRepo;
+    SqliteUsers userRepo;
+};
+
+// ================================================================
+// In-memory engine: flat hash maps keyed by id, one mutex
+// ================================================================
+
+// Book as held in memory: the author is an id into MemoryState::authors
+struct BookRecord {
+    int    id       = 0;
+    string title;
+    int    authorID = 0;
+    string isbn;
+    int    year     = 0;
+    int    quantity = 0;
+};
+
+struct MemoryState {
+    mutex                         lock;
+    FlatMap<BookRecord>           books;
+    FlatMap<Loan>                 loans;
+    FlatMap<User>                 users;
+    FlatMap<vector<int>>          loansByUser;     // userID -> loan ids
+    FlatMap<vector<int>>          booksByAuthor;   // authorID -> book ids
+    StringPool                    authors;         // normalized names
+    unordered_map<string, int>    authorByFold;    // lower-case name -> author id
+    unordered_map<string, int>    userByName;
+    unordered_map<string, int>    bookByIsbn;
+    int nextBookID = 1, nextLoanID = 1, nextUserID = 1;
+};
+
+static bool containsWord(const string& hay, const string& needle) {
+    // Mirrors SQLite LIKE '%kw%': ASCII case-insensitive substring
+    auto it = search(hay.begin(), hay.end(), needle.begin(), needle.end(),
+                     [](char a, char b) { return tolower(static_cast<unsigned char>(a)) ==
+                                                 tolower(static_cast<unsigned char>(b)); });
+    return it != hay.end() || needle.empty();
+}
+
+// Key for COLLATE NOCASE matching: ASCII lower case
+static string foldCase(string s) {
+    for (char& c : s) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+class MemoryBooks : public BookRepository {
+public:
+    explicit MemoryBooks(MemoryState& s) : st(s) {}
+
+    // ISBNs are validated and normalized as in SqliteBooks
+    int add(const Book& b) override {
+        int64_t key = normalizeIsbn(b.isbn);
+        if (!key) return -1;
+        lock_guard<mutex> g(st.lock);
+        string isbn = isbnText(key);
+        if (st.bookByIsbn.count(isbn)) return -1;
+        BookRecord rec = record(b);
+        rec.isbn = move(isbn);
+        rec.id = st.nextBookID++;
+        st.bookByIsbn[rec.isbn] = rec.id;
+        indexBook(rec);
+        int id = rec.id;
+        st.books.put(id, move(rec));
+        return id;
+    }
+    bool update(const Book& b) override {
+        int64_t key = normalizeIsbn(b.isbn);
+        if (!key) return false;
+        lock_guard<mutex> g(st.lock);
+        BookRecord* cur = st.books.find(b.id);
+        if (!cur) return false;
+        string isbn = isbnText(key);
+        if (cur->isbn != isbn) {
+            if (st.bookByIsbn.count(isbn)) return false;
+            st.bookByIsbn.erase(cur->isbn);
+            st.bookByIsbn[isbn] = b.id;
+        }
+        BookRecord rec = record(b);
+        rec.isbn = move(isbn);
+        if (rec.authorID != cur->authorID) {
+            unindexBook(*cur);
+            indexBook(rec);
+        }
+        *cur = move(rec);
+        return true;
+    }
+    bool remove(int bookID) override {
+        lock_guard<mutex> g(st.lock);
+        BookRecord* cur = st.books.find(bookID);
+        if (!cur) return false;
+        st.bookByIsbn.erase(cur->isbn);
+        unindexBook(*cur);
+        return st.books.erase(bookID);
+    }
+    bool findByID(int bookID, Book& out) override {
+        lock_guard<mutex> g(st.lock);
+        const BookRecord* b = st.books.find(bookID);
+        if (!b) return false;
+        out = book(*b);
+        return true;
+    }
+    vector<Book> list() override {
+        lock_guard<mutex> g(st.lock);
+        vector<Book> out;
+        out.reserve(st.books.size());
+        st.books.forEach([&](int, const BookRecord& b) { out.push_back(book(b)); });
+        sort(out.begin(), out.end(), [](const Book& a, const Book& b) { return a.id < b.id; });
+        return out;
+    }
+    vector<Book> search(const string& keyword, size_t limit) override {
+        lock_guard<mutex> g(st.lock);
+        // Match each distinct author once rather than once per title
+        vector<char> authorHit(st.authors.size() + 1, 0);
+        st.authors.forEach([&](int id, const string& name) { authorHit[id] = containsWord(name, keyword); });
+        vector<const BookRecord*> hits;
+        st.books.forEach([&](int, const BookRecord& b) {
+            if (authorHit[b.authorID] || containsWord(b.title, keyword)) hits.push_back(&b);
+        });
+        // Only the first limit ids need ordering or copying out
+        auto byID = [](const BookRecord* a, const BookRecord* b) { return a->id < b->id; };
+        if (limit && hits.size() > limit) {
+            partial_sort(hits.begin(), hits.begin() + limit, hits.end(), byID);
+            hits.resize(limit);
+        } else {
+            sort(hits.begin(), hits.end(), byID);
+        }
+        vector<Book> out;
+        out.reserve(hits.size());
+        for (const BookRecord* b : hits) out.push_back(book(*b));
+        return out;
+    }
+    vector<Book> byAuthor(const string& author) override {
+        lock_guard<mutex> g(st.lock);
+        vector<Book> out;
+        auto it = st.authorByFold.find(foldCase(normalizeAuthor(author)));
+        if (it == st.authorByFold.end()) return out;
+        if (const vector<int>* ids = st.booksByAuthor.find(it->second)) {
+            for (int bookID : *ids) out.push_back(book(*st.books.find(bookID)));
+        }
+        sort(out.begin(), out.end(), [](const Book& a, const Book& b) { return a.id < b.id; });
+        return out;
+    }
+    bool adjustQuantity(int bookID, int delta) override {
+        lock_guard<mutex> g(st.lock);
+        BookRecord* b = st.books.find(bookID);
+        if (!b || b->quantity + delta < 0) return false;
+        b->quantity += delta;
+        return true;
+    }
+
+    // Conversions and author index; caller holds st.lock
+    BookRecord record(const Book& b) {
+        BookRecord r;
+        r.id       = b.id;
+        r.title    = b.title;
+        r.authorID = authorID(b.author);
+        r.isbn     = b.isbn;
+        r.year     = b.year;
+        r.quantity = b.quantity;
+        return r;
+    }
+    Book book(const BookRecord& r) const {
+        Book b;
+        b.id       = r.id;
+        b.title    = r.title;
+        b.author   = st.authors.text(r.authorID);
+        b.isbn     = r.isbn;
+        b.year     = r.year;
+        b.quantity = r.quantity;
+        return b;
+    }
+    // Like the authors table, the first spelling of a name is kept
+    int authorID(const string& name) {
+        string norm = normalizeAuthor(name);
+        int& id = st.authorByFold[foldCase(norm)];
+        if (!id) id = st.authors.intern(norm);
+        return id;
+    }
+    void indexBook(const BookRecord& r) {
+        vector<int>* ids = st.booksByAuthor.find(r.authorID);
+        if (!ids) ids = &st.booksByAuthor.put(r.authorID, vector<int>());
+        ids->push_back(r.id);
+    }
+    void unindexBook(const BookRecord& r) {
+        if (vector<int>* ids = st.booksByAuthor.find(r.authorID))
+            ids->erase(std::remove(ids->begin(), ids->end(), r.id), ids->end());
+    }
+
+private:
+    MemoryState& st;
+};
+
+class MemoryLoans : public LoanRepository {
+public:
+    explicit MemoryLoans(MemoryState& s) : st(s) {}
+
+    int open(int userID, int bookID, int day) override {
+        lock_guard<mutex> g(st.lock);
+        Loan l;
+        l.id = st.nextLoanID++;
+        l.userID = userID;
+        l.bookID = bookID;
+        l.borrowDay = day;
+        st.loans.put(l.id, l);
+        indexLoan(l);
+        return l.id;
+    }
+    bool close(int userID, int bookID, int day) override {
+        lock_guard<mutex> g(st.lock);
+        const vector<int>* ids = st.loansByUser.find(userID);
+        if (!ids) return false;
+        Loan* best = nullptr;
+        for (int id : *ids) {
+            Loan* l = st.loans.find(id);
+            if (!l || l->bookID != bookID || l->returnDay) continue;
+            if (!best || l->borrowDay > best->borrowDay ||
+                (l->borrowDay == best->borrowDay && l->id > best->id)) best = l;
+        }
+        if (!best) return false;
+        best->returnDay = day;
+        return true;
+    }
+    vector<Loan> byUser(int userID) override {
+        lock_guard<mutex> g(st.lock);
+        vector<Loan> out;
+        if (const vector<int>* ids = st.loansByUser.find(userID)) {
+            for (int id : *ids) if (const Loan* l = st.loans.find(id)) out.push_back(*l);
+        }
+        return out;
+    }
+    int countOverdue(int userID, int today, int loanDays) override {
+        lock_guard<mutex> g(st.lock);
+        int n = 0;
+        if (const vector<int>* ids = st.loansByUser.find(userID)) {
+            for (int id : *ids) {
+                const Loan* l = st.loans.find(id);
+                if (l && !l->returnDay && l->borrowDay + loanDays < today) ++n;
+            }
+        }
+        return n;
+    }
+
+    // Caller holds st.lock
+    void indexLoan(const Loan& l) {
+        vector<int>* ids = st.loansByUser.find(l.userID);
+        if (!ids) ids = &st.loansByUser.put(l.userID, vector<int>());
+        ids->push_back(l.id);
+    }
+
+private:
+    MemoryState& st;
+};
+
+class MemoryUsers : public UserRepository {
+public:
+    explicit MemoryUsers(MemoryState& s) : st(s) {}
+
+    int add(const User& u) override {
+        lock_guard<mutex> g(st.lock);
+        if (st.userByName.count(u.username)) return -1;
+        if (u.role != "admin" && u.role != "student") return -1;
+        User copy = u;
+        copy.id = st.nextUserID++;
+        st.userByName[copy.username] = copy.id;
+        st.users.put(copy.id, copy);
+        return copy.id;
+    }
+    bool findByID(int userID, User& out) override {
+        lock_guard<mutex> g(st.lock);
+        const User* u = st.users.find(userID);
+        if (!u) return false;
+        out = *u;
+        return true;
+    }
+    bool findByUsername(const string& username, User& out) override {
+        lock_guard<mutex> g(st.lock);
+        auto it = st.userByName.find(username);
+        if (it == st.userByName.end()) return false;
+        out = *st.users.find(it->second);
+        return true;
+    }
+
+private:
+    MemoryState& st;
+};
+
+class MemoryStorage : public StorageEngine {
+public:
+    MemoryStorage() : bookRepo(state), loanRepo(state), userRepo(state) {}
+
+    const char*     name() const override { return "memory"; }
+    BookRepository& books() override { return bookRepo; }
+    LoanRepository& loans() override { return loanRepo; }
+    UserRepository& users() override { return userRepo; }
+
+    // Bulk load every table from an open SQLite handle
+    void load(sqlite3* src) {
+        lock_guard<mutex> g(state.lock);
+        {
+            Stmt s(src, "SELECT b.id,b.title,a.name,b.isbn,b.year,b.quantity FROM books b "
+                        "JOIN authors a ON a.id=b.author_id;");
+            while (s.step() == SQLITE_ROW) {
+                Book b;
+                s.into(b.id, b.title, b.author, b.isbn, b.year, b.quantity);
+                BookRecord rec = bookRepo.record(b);
+                state.bookByIsbn[rec.isbn] = rec.id;
+                state.nextBookID = max(state.nextBookID, rec.id + 1);
+                bookRepo.indexBook(rec);
+                state.books.put(rec.id, move(rec));
+            }
+        }
+        {
+            Stmt s(src, "SELECT id,name,role,username,password FROM users;");
+            while (s.step() == SQLITE_ROW) {
+                User u;
+                s.into(u.id, u.name, u.role, u.username, u.password);
+                state.userByName[u.username] = u.id;
+                state.nextUserID = max(state.nextUserID, u.id + 1);
+                state.users.put(u.id, u);
+            }
+        }
+        {
+            Stmt s(src, "SELECT id,user_id,book_id,borrow_date,return_date FROM loans;");
+            while (s.step() == SQLITE_ROW) {
+                Loan l;
+                s.into(l.id, l.userID, l.bookID, l.borrowDay, l.returnDay);
+                state.nextLoanID = max(state.nextLoanID, l.id + 1);
+                state.loans.put(l.id, l);
+                loanRepo.indexLoan(l);
+            }
+        }
+    }
+
+    // Write to path.tmp, then rename over path so readers never see a torn file
+    bool snapshot(const string& path) override {
+        string tmp = path + ".tmp";
+        std::remove(tmp.c_str());
+        sqlite3* out = nullptr;
+        if (sqlite3_open(tmp.c_str(), &out) != SQLITE_OK) {
+            sqlite3_close(out);
+            return false;
+        }
+        bool ok = true;
+        try {
+            createSchema(out);
+            sqlite3_exec(out, "BEGIN;", nullptr, nullptr, nullptr);
+            lock_guard<mutex> g(state.lock);
+            // Pool ids are dense from 1 in insertion order, like fresh rowids
+            Stmt a(out, "INSERT INTO authors(id,name) VALUES(?,?);");
+            state.authors.forEach([&](int id, const string& name) {
+                a.bind(id, name);
+                ok = ok && a.done();
+                a.reset();
+            });
+            Stmt b(out, "INSERT INTO books(id,title,author_id,isbn,year,quantity) VALUES(?,?,?,?,?,?);");
+            state.books.forEach([&](int, const BookRecord& x) {
+                b.bind(x.id, x.title, x.authorID, x.isbn, x.year, x.quantity);
+                ok = ok && b.done();
+                b.reset();
+            });
+            Stmt u(out, "INSERT INTO users(id,name,role,username,password) VALUES(?,?,?,?,?);");
+            state.users.forEach([&](int, const User& x) {
+                u.bind(x.id, x.name, x.role, x.username, x.password);
+                ok = ok && u.done();
+                u.reset();
+            });
+            Stmt l(out, "INSERT INTO loans(id,user_id,book_id,borrow_date,return_date) VALUES(?,?,?,?,?);");
+            state.loans.forEach([&](int, const Loan& x) {
+                if (x.returnDay) l.bind(x.id, x.userID, x.bookID, x.borrowDay, x.returnDay);
+                else             l.bind(x.id, x.userID, x.bookID, x.borrowDay, nullptr);
+                ok = ok && l.done();
+                l.reset();
+            });
+        } catch (const exception&) {
+            ok = false;
+        }
+        ok = ok && sqlite3_exec(out, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+        sqlite3_close(out);
+        if (!ok) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        std::remove(path.c_str());
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    MemoryState state;
+    MemoryBooks bookRepo;
+    MemoryLoans loanRepo;
+    MemoryUsers userRepo;
+};
+
+} // namespace
+
+unique_ptr<StorageEngine> makeSqliteStorage(sqlite3* handle) {
+    return unique_ptr<StorageEngine>(new SqliteStorage(handle));
+}
+
+unique_ptr<StorageEngine> makeMemoryStorage(sqlite3* source) {
+    unique_ptr<MemoryStorage> engine(new MemoryStorage());
+    if (source) engine->load(source);
+    return unique_ptr<StorageEngine>(engine.release());
+}
+
+// ================================================================
+// Periodic snapshot thread
+// ================================================================
+struct SnapshotScheduler::Impl {
+    StorageEngine&     engine;
+    string             path;
+    chrono::seconds    interval;
+    mutex              m;
+    condition_variable cv;
+    bool               stopping = false;
+    thread             worker;
+
+    Impl(StorageEngine& e, string p, int secs)
+        : engine(e), path(move(p)), interval(secs > 0 ? secs : 1) {
+        worker = thread([this] { run(); });
+    }
+    void run() {
+        unique_lock<mutex> g(m);
+        while (!cv.wait_for(g, interval, [this] { return stopping; })) {
+            g.unlock();
+            engine.snapshot(path);
+            g.lock();
+        }
+    }
+};
+
+SnapshotScheduler::SnapshotScheduler(StorageEngine& engine, string path, int intervalSeconds)
+    : impl(new Impl(engine, move(path), intervalSeconds)) {}
+
+SnapshotScheduler::~SnapshotScheduler() {
+    {
+        lock_guard<mutex> g(impl->m);
+        impl->stopping = true;
+    }
+    impl->cv.notify_all();
+    impl->worker.join();
+    // Final snapshot so nothing since the last tick is lost
+    impl->engine.snapshot(impl->path);
+}
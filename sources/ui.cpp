@@ -4,14 +4,19 @@
 
 #include "ui.h"
 #include "core.h"
+#include "scan.h"
 
 #include <FL/Fl.H>
 #include <FL/Fl_Window.H>
 #include <FL/Fl_Button.H>
 #include <FL/Fl_Input.H>
 #include <FL/Fl_Multiline_Output.H>
+#include <FL/Fl_Check_Button.H>
+#include <map>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 struct LoginInputs {
     Fl_Input* user;
@@ -98,10 +103,19 @@ void openMenuWindow() {
     addButton("Search Book",            [](Fl_Widget*, void*) { openSearchBookWindow(); });
     addButton("View Book Details",      [](Fl_Widget*, void*) { openViewBookDetailsWindow(); });
     addButton("Borrow Book",            [](Fl_Widget*, void*) { openBorrowBookWindow(); });
+    addButton("Checkout Cart",          [](Fl_Widget*, void*) { openCheckoutCartWindow(); });
     addButton("Return Book",            [](Fl_Widget*, void*) { openReturnBookWindow(); });
+    addButton("Scan Mode",              [](Fl_Widget*, void*) { openScanModeWindow(); });
     addButton("View My Borrow History", [](Fl_Widget*, void*) { openViewBorrowHistoryWindow(); });
     addButton("Check Overdue Items",    [](Fl_Widget*, void*) { openCheckOverdueWindow(); });
     addButton("Register New User",      [](Fl_Widget*, void*) { openRegisterUserWindow(); });
+    win->size(300, y);
+    Result<PatronSummary> sum = fetchPatronSummary(getCurrentUserID());
+    if (sum) {
+        std::string status = "Library Menu - " + std::to_string(sum.value().openLoans) +
+                             " on loan, " + std::to_string(sum.value().overdue) + " overdue";
+        win->copy_label(status.c_str());
+    }
     win->end();
     win->show();
 }
@@ -281,7 +295,7 @@ void openBorrowBookWindow() {
     auto* inp = new BorrowBookInputs {
         new Fl_Input(120, 50, 200, 30, "Book ID:")
     };
-    Fl_Button* btn = new Fl_Button(130, 100, 100, 30, "Borrow");
+    Fl_Button* btn = new Fl_Button(70, 100, 100, 30, "Borrow");
     btn->callback([](Fl_Widget* w, void* data){
         auto* i = static_cast<BorrowBookInputs*>(data);
         try {
@@ -294,6 +308,93 @@ void openBorrowBookWindow() {
             showErrorMessage("Invalid Book ID or no copies left.");
         }
     }, inp);
+    Fl_Button* hold = new Fl_Button(190, 100, 100, 30, "Place Hold");
+    hold->callback([](Fl_Widget* w, void* data){
+        auto* i = static_cast<BorrowBookInputs*>(data);
+        try {
+            int bid = std::stoi(i->id->value());
+            if (placeHold(bid)) {
+                w->window()->hide();
+            }
+        }
+        catch(...) {
+            showErrorMessage("Invalid Book ID.");
+        }
+    }, inp);
+    win->end();
+    win->set_non_modal();
+    win->show();
+}
+
+//--------------------------------------------------------------
+// Checkout Cart Dialog: collect several IDs, borrow in one batch
+//--------------------------------------------------------------
+struct CartInputs {
+    Fl_Input*            id;
+    Fl_Multiline_Output* list;
+    Fl_Check_Button*     allOrNothing;
+    std::vector<int>     ids;
+    std::string          text;
+};
+
+static void refreshCart(CartInputs* c) {
+    c->text.clear();
+    for (int bid : c->ids) c->text += "Book ID " + std::to_string(bid) + "\n";
+    c->list->value(c->text.c_str());
+}
+
+static void cartAdd_cb(Fl_Widget* /*w*/, void* data) {
+    auto* c = static_cast<CartInputs*>(data);
+    try {
+        c->ids.push_back(std::stoi(c->id->value()));
+        c->id->value("");
+        refreshCart(c);
+    }
+    catch(...) {
+        showErrorMessage("Invalid Book ID.");
+    }
+}
+
+void openCheckoutCartWindow() {
+    Fl_Window* win = new Fl_Window(400, 360, "Checkout Cart");
+    auto* inp = new CartInputs {
+        new Fl_Input(120, 20, 150, 30, "Book ID:"),
+        new Fl_Multiline_Output(20, 70, 360, 180),
+        new Fl_Check_Button(20, 260, 250, 30, "All or nothing"),
+        {}, {}
+    };
+    Fl_Button* add = new Fl_Button(280, 20, 100, 30, "Add");
+    add->callback(cartAdd_cb, inp);
+    inp->id->when(FL_WHEN_ENTER_KEY);
+    inp->id->callback(cartAdd_cb, inp);
+
+    Fl_Button* btn = new Fl_Button(150, 305, 100, 30, "Checkout");
+    btn->callback([](Fl_Widget* w, void* data){
+        auto* c = static_cast<CartInputs*>(data);
+        if (c->ids.empty()) {
+            showErrorMessage("Cart is empty.");
+            return;
+        }
+        BatchMode mode = c->allOrNothing->value() ? BatchMode::AllOrNothing
+                                                  : BatchMode::Partial;
+        BatchResult r = borrowBooks(c->ids, mode);
+        if (!r.status) {
+            showErrorMessage("Checkout failed: " + r.status.error().message());
+            return;
+        }
+        std::string failed;
+        for (const BatchItem& it : r.items) {
+            if (it.code != ErrorCode::Ok)
+                failed += "Book ID " + std::to_string(it.bookID) + ": " + errorText(it.code) + "\n";
+        }
+        if (!failed.empty()) {
+            showErrorMessage("Borrowed " + std::to_string(r.succeeded) + " of " +
+                             std::to_string(c->ids.size()) + ".\n" + failed);
+        }
+        c->ids.clear();
+        refreshCart(c);
+        if (failed.empty()) w->window()->hide();
+    }, inp);
     win->end();
     win->set_non_modal();
     win->show();
@@ -327,14 +428,134 @@ void openReturnBookWindow() {
     win->show();
 }
 
+//--------------------------------------------------------------
+// Scan Mode Dialog: keyboard-wedge or file/pipe barcode stream
+//--------------------------------------------------------------
+struct ScanInputs {
+    Fl_Input*                     code;
+    Fl_Input*                     feed;
+    Fl_Check_Button*              returnMode;
+    Fl_Multiline_Output*          log;
+    std::unique_ptr<ScanPipeline> pipeline;
+    std::string                   text;
+    unsigned                      serial = 0;   // key in scanWindows
+    int                           userID = 0;   // patron scans are lent to
+};
+
+// Open scan windows by serial. Results posted with Fl::awake may
+// arrive after their window has closed, so they look it up here.
+static std::map<unsigned, ScanInputs*> scanWindows;
+static unsigned                        nextScanSerial = 1;
+
+struct ScanUpdate {
+    unsigned    serial;
+    std::string line;
+};
+
+// Runs on the FLTK thread via Fl::awake
+static void scanUpdate_cb(void* data) {
+    std::unique_ptr<ScanUpdate> up(static_cast<ScanUpdate*>(data));
+    auto it = scanWindows.find(up->serial);
+    if (it == scanWindows.end()) return;
+    ScanInputs* s = it->second;
+    s->text = up->line + s->text;
+    s->log->value(s->text.c_str());
+}
+
+// Applies every scan already queued, then frees the pipeline and window
+static void closeScanWindow(ScanInputs* s) {
+    scanWindows.erase(s->serial);
+    s->pipeline.reset();   // drains; its results are dropped by scanUpdate_cb
+    Fl_Window* win = s->code->window();
+    win->hide();
+    Fl::delete_widget(win);
+    delete s;
+}
+
+void closeScanWindows() {
+    while (!scanWindows.empty()) closeScanWindow(scanWindows.begin()->second);
+}
+
+// Scans go to the patron who opened the window; once the session has
+// changed the window is closed instead of lending to someone else
+static bool scanSessionValid(ScanInputs* s) {
+    if (isUserLoggedIn() && getCurrentUserID() == s->userID) return true;
+    closeScanWindow(s);
+    showErrorMessage("Scan window closed: the session has changed.");
+    return false;
+}
+
+static ScanPipeline& scanPipeline(ScanInputs* s) {
+    if (!s->pipeline) {
+        ScanMode mode = s->returnMode->value() ? ScanMode::Return : ScanMode::Borrow;
+        s->returnMode->deactivate();
+        unsigned serial = s->serial;
+        s->pipeline.reset(new ScanPipeline(getDBPath(), mode, s->userID,
+            [serial](const ScanEvent& ev) {
+                std::string line = "#" + std::to_string(ev.seq) + " " + ev.barcode + ": " +
+                                   errorText(ev.code) + "\n";
+                Fl::awake(scanUpdate_cb, new ScanUpdate{serial, line});
+            }));
+    }
+    return *s->pipeline;
+}
+
+void openScanModeWindow() {
+    if (!isUserLoggedIn()) {
+        showErrorMessage("You must be logged in to scan.");
+        return;
+    }
+    Fl_Window* win = new Fl_Window(420, 400, "Scan Mode");
+    auto* inp = new ScanInputs {
+        new Fl_Input(120, 20, 280, 30, "Scan:"),
+        new Fl_Input(120, 60, 170, 30, "File/pipe:"),
+        new Fl_Check_Button(120, 100, 200, 30, "Return mode"),
+        new Fl_Multiline_Output(20, 140, 380, 240),
+        nullptr, {}, nextScanSerial++, getCurrentUserID()
+    };
+    scanWindows[inp->serial] = inp;
+    // Scanner acts as a keyboard ending each code with Enter
+    inp->code->when(FL_WHEN_ENTER_KEY);
+    inp->code->callback([](Fl_Widget* /*w*/, void* data) {
+        auto* s = static_cast<ScanInputs*>(data);
+        if (!scanSessionValid(s)) return;
+        scanPipeline(s).submit(s->code->value());
+        s->code->value("");
+        s->code->take_focus();
+    }, inp);
+    Fl_Button* feed = new Fl_Button(300, 60, 100, 30, "Feed");
+    feed->callback([](Fl_Widget* /*w*/, void* data) {
+        auto* s = static_cast<ScanInputs*>(data);
+        if (!scanSessionValid(s)) return;
+        if (s->feed->value()[0] == '\0') {
+            showErrorMessage("Enter a file or pipe path.");
+            return;
+        }
+        scanPipeline(s).feedFrom(s->feed->value());
+    }, inp);
+    // Closing the window finishes the queued scans before it goes
+    win->callback([](Fl_Widget* /*w*/, void* data) {
+        closeScanWindow(static_cast<ScanInputs*>(data));
+    }, inp);
+    win->end();
+    win->set_non_modal();
+    win->show();
+    inp->code->take_focus();
+}
+
 //--------------------------------------------------------------
 // View Borrow History Dialog
 //--------------------------------------------------------------
 void openViewBorrowHistoryWindow() {
     Fl_Window* win = new Fl_Window(400, 300, "My Borrow History");
     Fl_Multiline_Output* out = new Fl_Multiline_Output(10, 10, 380, 220);
-    Fl_Button* btn = new Fl_Button(150, 240, 100, 30, "Close");
+    Fl_Button* full = new Fl_Button(90, 240, 100, 30, "Full History");
+    Fl_Button* btn = new Fl_Button(210, 240, 100, 30, "Close");
     fetchBorrowHistory(getCurrentUserID());
+    fetchHolds(getCurrentUserID());
+    full->callback([](Fl_Widget* /*w*/, void*) {
+        fetchBorrowHistory(getCurrentUserID(), true);
+    });
     btn->callback([](Fl_Widget* w, void*) {
         w->window()->hide();
     });